@@ -10,204 +10,239 @@
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+
+#include "../common/sphere_scene.h"
+#include "../common/rasterizer.h"
+#include "../common/lighting.h"
+#include "../common/render_pipeline.h"
+
+// Tiled light culling: each tile keeps the scene lights whose sphere of influence reaches the
+// frustum through the tile between the nearest and farthest view depth it can contain. The range
+// starts as [near, far]; a tile worker narrows it to the triangles binned to the tile, and the
+// visibility-buffer resolve to the pixels it is about to shade. Per-pixel lighting only loops
+// over its tile's list.
+const bool useTiledLightCulling = true;
+
+// World-space planes through the tile's edges, normalized: dot(xyz, p) + w is a signed distance,
+// positive inside
+struct TileFrustum {
+    glm::vec4 sides[4];
+};
+std::vector<TileFrustum> tileFrusta(tileCountX * tileCountY);
+glm::vec4 viewDepthPlane;  // dot(xyz, p) + w is the view depth w_clip of world point p
+float viewDepthScale;      // world distance per unit of w_clip along the view direction
+std::vector<std::vector<PointLight>> tileLights(tileCountX * tileCountY); // written by the tile's owning worker only
+
+// Replaces the tile's light list with the scene lights that can reach a point of the tile with
+// view depth w_clip in [nearest_w, farthest_w]
+void cullTileLights(int tile, float nearest_w, float farthest_w) {
+    std::vector<PointLight>& lights = tileLights[tile];
+    lights.clear();
+    for (const PointLight& light : sceneLights) {
+        if (useTiledLightCulling) {
+            float depth = (glm::dot(glm::vec3(viewDepthPlane), light.position) + viewDepthPlane.w) * viewDepthScale;
+            if (depth + light.radius < nearest_w * viewDepthScale || depth - light.radius > farthest_w * viewDepthScale) {
+                continue;
+            }
+            bool outside = false;
+            for (const glm::vec4& side : tileFrusta[tile].sides) {
+                outside = outside || glm::dot(glm::vec3(side), light.position) + side.w < -light.radius;
+            }
+            if (outside) {
+                continue;
+            }
+        }
+        lights.push_back(light);
+    }
+}
 
-#include "sphere_scene.h"
-
-const int screenWidth = 512;
-const int screenHeight = 512;
-
-std::vector<unsigned char> frameBuffer(screenWidth* screenHeight * 3);
-std::vector<float> depthBuffer(screenWidth* screenHeight);
-
+// Builds the tile frusta for the camera and gives every tile the lights between the near and
+// far planes
+void setupLightCulling(const glm::mat4& viewProjection, float nearVal, float farVal) {
+    // dot(plane, vp * p) == dot(transpose(vp) * plane, p); a tile spans [x0, x1] x [y0, y1] in NDC
+    glm::mat4 vp_transposed = glm::transpose(viewProjection);
+    glm::vec4 depth_plane = vp_transposed * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    viewDepthScale = 1.0f / glm::length(glm::vec3(depth_plane));
+    viewDepthPlane = depth_plane;
+
+    for (int tile = 0; tile < tileCountX * tileCountY; ++tile) {
+        ScreenRect rect = tileRect(tile);
+        float x0 = 2.0f * rect.minX / screenWidth - 1.0f;
+        float x1 = 2.0f * (rect.maxX + 1) / screenWidth - 1.0f;
+        float y0 = 1.0f - 2.0f * (rect.maxY + 1) / screenHeight;
+        float y1 = 1.0f - 2.0f * rect.minY / screenHeight;
+        const glm::vec4 clip_sides[4] = {
+            glm::vec4(1.0f, 0.0f, 0.0f, -x0),
+            glm::vec4(-1.0f, 0.0f, 0.0f, x1),
+            glm::vec4(0.0f, 1.0f, 0.0f, -y0),
+            glm::vec4(0.0f, -1.0f, 0.0f, y1)
+        };
+        for (int k = 0; k < 4; ++k) {
+            glm::vec4 plane = vp_transposed * clip_sides[k];
+            tileFrusta[tile].sides[k] = plane / glm::length(glm::vec3(plane));
+        }
+        cullTileLights(tile, nearVal, farVal);
+    }
+}
 
-const glm::vec3 mat_ka = glm::vec3(0.0f, 1.0f, 0.0f);
-const glm::vec3 mat_kd = glm::vec3(0.0f, 0.5f, 0.0f);
-const glm::vec3 mat_ks = glm::vec3(0.5f, 0.5f, 0.5f);
-const float mat_p_shininess = 32.0f;
+// PhongShader runs calculate_phong_pixel_color on 4 pixels per SSE2 vector and normalizes with
+// the rsqrt estimate refined by one Newton-Raphson step (about 22 of 24 mantissa bits); without
+// SSE2, or with useSimdShading off, every pixel goes through the scalar function.
+const bool useSimdShading = true;
 
-const float light_Ia_intensity = 0.2f;
-const glm::vec3 light_pos_world = glm::vec3(-4.0f, 4.0f, -3.0f);
-const glm::vec3 light_Il_intensity = glm::vec3(1.0f, 1.0f, 1.0f); // White light
+// Lights evaluated per shaded pixel, summed over all tile workers
+std::atomic<int64_t> lightEvaluations(0);
 
-const glm::vec3 eye_pos_world = glm::vec3(0.0f, 0.0f, 0.0f);
-const float gamma_val = 2.2f;
-// ---        ߽ ---
-glm::mat4 g_modelMatrix;
-glm::vec3 g_sphere_center_world;
+#ifdef RASTER_HAS_SSE2
+// 1/sqrt(v): the SSE estimate plus one Newton-Raphson step
+__m128 rsqrtSse2(__m128 v) {
+    __m128 estimate = _mm_rsqrt_ps(v);
+    __m128 half_v_e2 = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), _mm_mul_ps(estimate, estimate));
+    return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f), half_v_e2));
+}
 
+__m128 dotSse2(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
 
-float edgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
-    return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
+void normalizeSse2(__m128& x, __m128& y, __m128& z) {
+    __m128 scale = rsqrtSse2(dotSse2(x, y, z, x, y, z));
+    x = _mm_mul_ps(x, scale);
+    y = _mm_mul_ps(y, scale);
+    z = _mm_mul_ps(z, scale);
 }
 
-float interpolateDepth(const glm::vec3& lambda, const glm::vec4& v0_clip, const glm::vec4& v1_clip, const glm::vec4& v2_clip) {
-    float epsilon_w = 1e-6f;
-    if (std::abs(v0_clip.w) < epsilon_w || std::abs(v1_clip.w) < epsilon_w || std::abs(v2_clip.w) < epsilon_w) {
-        return std::numeric_limits<float>::max();
+// specularPower of 4 values. SSE2 has no gather, so the table path looks up lane by lane.
+template <typename Material>
+__m128 specularPowerSse2(__m128 x) {
+    if (useFastSpecularPower && specularShininessIsInteger<Material>) {
+        return IntegerPower<specularShininessIsInteger<Material> ? static_cast<int>(Material::shininess) : 0>::eval(x);
     }
-
-    float inv_w0 = 1.0f / v0_clip.w;
-    float inv_w1 = 1.0f / v1_clip.w;
-    float inv_w2 = 1.0f / v2_clip.w;
-
-    float interpolated_inv_w = lambda.x * inv_w0 + lambda.y * inv_w1 + lambda.z * inv_w2;
-
-    if (std::abs(interpolated_inv_w) < std::numeric_limits<float>::epsilon()) {
-        return std::numeric_limits<float>::max();
+    float lanes[4];
+    _mm_storeu_ps(lanes, x);
+    for (float& lane : lanes) {
+        lane = specularPower<Material>(lane);
     }
-
-    float z_ndc0 = v0_clip.z * inv_w0;
-    float z_ndc1 = v1_clip.z * inv_w1;
-    float z_ndc2 = v2_clip.z * inv_w2;
-
-    float interpolated_z_ndc_over_w = lambda.x * z_ndc0 * inv_w0 +
-        lambda.y * z_ndc1 * inv_w1 +
-        lambda.z * z_ndc2 * inv_w2;
-
-    float final_interpolated_z_ndc = interpolated_z_ndc_over_w / interpolated_inv_w;
-
-    return final_interpolated_z_ndc;
+    return _mm_loadu_ps(lanes);
 }
 
-
-glm::vec3 calculate_phong_pixel_color(const glm::vec3& pixel_world_pos, const glm::vec3& pixel_world_normal_normalized) {
-    // Ambient
-    glm::vec3 ambient_color = light_Ia_intensity * mat_ka;
-
-    // Diffuse
-    glm::vec3 light_dir = glm::normalize(light_pos_world - pixel_world_pos);
-    float diff_factor = std::max(0.0f, glm::dot(pixel_world_normal_normalized, light_dir));
-    glm::vec3 diffuse_color = light_Il_intensity * mat_kd * diff_factor;
-
-    // Specular
-    glm::vec3 view_dir = glm::normalize(eye_pos_world - pixel_world_pos);
-    glm::vec3 reflect_dir = glm::reflect(-light_dir, pixel_world_normal_normalized);
-   
-    float spec_factor = std::pow(std::max(0.0f, glm::dot(view_dir, reflect_dir)), mat_p_shininess);
-    glm::vec3 specular_color = light_Il_intensity * mat_ks * spec_factor;
-
-    glm::vec3 final_color_linear = ambient_color + diffuse_color + specular_color;
-    final_color_linear = glm::clamp(final_color_linear, 0.0f, 1.0f);
-
-    // Gamma Correction
-    glm::vec3 final_color_gamma_corrected = glm::vec3(
-        std::pow(final_color_linear.r, 1.0f / gamma_val),
-        std::pow(final_color_linear.g, 1.0f / gamma_val),
-        std::pow(final_color_linear.b, 1.0f / gamma_val)
-    );
-    return glm::clamp(final_color_gamma_corrected, 0.0f, 1.0f);
+// lightFalloff of 4 squared distances
+__m128 lightFalloffSse2(__m128 distance_sq, float radius) {
+    __m128 t = _mm_div_ps(distance_sq, _mm_set1_ps(radius * radius));
+    __m128 window = _mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(t, t)));
+    return _mm_mul_ps(window, window);
 }
 
-
-void rasterizeTriangle(
-    const glm::vec4& v0_clip, const glm::vec4& v1_clip, const glm::vec4& v2_clip,
-    const glm::vec3& v0_world, const glm::vec3& v1_world, const glm::vec3& v2_world,
-    const glm::vec3& n0_world_norm, const glm::vec3& n1_world_norm, const glm::vec3& n2_world_norm,
-    bool print_debug = false) {
-
-    float epsilon_w = 1e-5f;
-    if (v0_clip.w < epsilon_w && v1_clip.w < epsilon_w && v2_clip.w < epsilon_w) {
-        // if (print_debug) std::cout << "Triangle culled: all w < epsilon" << std::endl;
-        return;
+// calculate_phong_pixel_color for the 4 pixels starting at lane i, from world positions in
+// varyings[0..2] and normals of any positive length in varyings[3..5]
+template <typename Material>
+void shadePhongSse2(PixelBatch<6>& batch, int i, const std::vector<PointLight>& lights) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 px = _mm_loadu_ps(batch.varyings[0] + i);
+    __m128 py = _mm_loadu_ps(batch.varyings[1] + i);
+    __m128 pz = _mm_loadu_ps(batch.varyings[2] + i);
+    __m128 nx = _mm_loadu_ps(batch.varyings[3] + i);
+    __m128 ny = _mm_loadu_ps(batch.varyings[4] + i);
+    __m128 nz = _mm_loadu_ps(batch.varyings[5] + i);
+    normalizeSse2(nx, ny, nz);
+
+    __m128 vx = _mm_sub_ps(_mm_set1_ps(eye_pos_world.x), px);
+    __m128 vy = _mm_sub_ps(_mm_set1_ps(eye_pos_world.y), py);
+    __m128 vz = _mm_sub_ps(_mm_set1_ps(eye_pos_world.z), pz);
+    normalizeSse2(vx, vy, vz);
+
+    glm::vec3 ambient_color = light_Ia_intensity * Material::ka;
+    __m128 color[3] = { _mm_set1_ps(ambient_color.r), _mm_set1_ps(ambient_color.g), _mm_set1_ps(ambient_color.b) };
+    for (const PointLight& light : lights) {
+        __m128 lx = _mm_sub_ps(_mm_set1_ps(light.position.x), px);
+        __m128 ly = _mm_sub_ps(_mm_set1_ps(light.position.y), py);
+        __m128 lz = _mm_sub_ps(_mm_set1_ps(light.position.z), pz);
+        __m128 distance_sq = dotSse2(lx, ly, lz, lx, ly, lz);
+        __m128 falloff = lightFalloffSse2(distance_sq, light.radius);
+        if (_mm_movemask_ps(_mm_cmpgt_ps(falloff, zero)) == 0) {
+            continue;
+        }
+        normalizeSse2(lx, ly, lz);
+        __m128 n_dot_l = dotSse2(nx, ny, nz, lx, ly, lz);
+        __m128 diff_factor = _mm_max_ps(zero, n_dot_l);
+
+        // reflect(-l, n) = 2 dot(n, l) n - l
+        __m128 two_n_dot_l = _mm_add_ps(n_dot_l, n_dot_l);
+        __m128 rx = _mm_sub_ps(_mm_mul_ps(two_n_dot_l, nx), lx);
+        __m128 ry = _mm_sub_ps(_mm_mul_ps(two_n_dot_l, ny), ly);
+        __m128 rz = _mm_sub_ps(_mm_mul_ps(two_n_dot_l, nz), lz);
+        __m128 spec_factor = specularPowerSse2<Material>(_mm_max_ps(zero, dotSse2(vx, vy, vz, rx, ry, rz)));
+
+        for (int c = 0; c < 3; ++c) {
+            __m128 radiance = _mm_mul_ps(_mm_set1_ps(light.intensity[c]), falloff);
+            color[c] = _mm_add_ps(color[c], _mm_mul_ps(_mm_mul_ps(radiance, _mm_set1_ps(Material::kd[c])), diff_factor));
+            color[c] = _mm_add_ps(color[c], _mm_mul_ps(_mm_mul_ps(radiance, _mm_set1_ps(Material::ks[c])), spec_factor));
+        }
     }
 
-    glm::vec3 v0_ndc, v1_ndc, v2_ndc;
-    if (std::abs(v0_clip.w) < epsilon_w || std::abs(v1_clip.w) < epsilon_w || std::abs(v2_clip.w) < epsilon_w) {
-     
-        return;
+    float* channels[3] = { batch.color_r + i, batch.color_g + i, batch.color_b + i };
+    for (int c = 0; c < 3; ++c) {
+        _mm_storeu_ps(channels[c], _mm_min_ps(_mm_max_ps(color[c], zero), one));
     }
+}
+#endif
 
-    v0_ndc = glm::vec3(v0_clip) / v0_clip.w;
-    v1_ndc = glm::vec3(v1_clip) / v1_clip.w;
-    v2_ndc = glm::vec3(v2_clip) / v2_clip.w;
-
-    glm::vec2 v0_screen = glm::vec2((v0_ndc.x + 1.0f) * 0.5f * screenWidth, (1.0f - v0_ndc.y) * 0.5f * screenHeight);
-    glm::vec2 v1_screen = glm::vec2((v1_ndc.x + 1.0f) * 0.5f * screenWidth, (1.0f - v1_ndc.y) * 0.5f * screenHeight);
-    glm::vec2 v2_screen = glm::vec2((v2_ndc.x + 1.0f) * 0.5f * screenWidth, (1.0f - v2_ndc.y) * 0.5f * screenHeight);
-
-    int minX = static_cast<int>(std::max(0.0f, std::min({ v0_screen.x, v1_screen.x, v2_screen.x })));
-    int maxX = static_cast<int>(std::min(static_cast<float>(screenWidth - 1), std::ceil(std::max({ v0_screen.x, v1_screen.x, v2_screen.x }))));
-    int minY = static_cast<int>(std::max(0.0f, std::min({ v0_screen.y, v1_screen.y, v2_screen.y })));
-    int maxY = static_cast<int>(std::min(static_cast<float>(screenHeight - 1), std::ceil(std::max({ v0_screen.y, v1_screen.y, v2_screen.y }))));
-
-    float area = edgeFunction(v0_screen, v1_screen, v2_screen);
+// Phong lighting per pixel from the interpolated world position and normal, with the lights of
+// the pixel's tile
+template <typename Material>
+struct PhongShader {
+    static const int varyingCount = 6; // world position, world normal
 
-    if (std::abs(area) < std::numeric_limits<float>::epsilon()) {
-        // if (print_debug) std::cout << "Triangle culled: zero area" << std::endl;
-        return;
+    static const char* name() {
+        return "Phong";
     }
 
-    bool first_pixel_debug_printed = !print_debug;
-
-    for (int y = minY; y <= maxY; ++y) {
-        for (int x = minX; x <= maxX; ++x) {
-            glm::vec2 p = { static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f };
-
-            float w0_edge = edgeFunction(v1_screen, v2_screen, p);
-            float w1_edge = edgeFunction(v2_screen, v0_screen, p);
-            float w2_edge = edgeFunction(v0_screen, v1_screen, p);
-
-            if (w0_edge >= 0 && w1_edge >= 0 && w2_edge >= 0) {
-                glm::vec3 lambda = glm::vec3(w0_edge / area, w1_edge / area, w2_edge / area);
-                float z_ndc_interpolated = interpolateDepth(lambda, v0_clip, v1_clip, v2_clip);
-
-                if (!first_pixel_debug_printed) {
-                    std::cout << "  Inside rasterizeTriangle (Phong, Tri0, Pixel0): z_ndc_interpolated = " << z_ndc_interpolated << std::endl;
-             
-                }
-
-                if (z_ndc_interpolated < -1.0f - 1e-5f || z_ndc_interpolated > 1.0f + 1e-5f) {
-                    continue;
-                }
-
-                float z_screen = (z_ndc_interpolated + 1.0f) * 0.5f;
-
-                int index = y * screenWidth + x;
-                if (z_screen < depthBuffer[index]) {
-                    depthBuffer[index] = z_screen;
-
-                    // Perspective-correct interpolation for world position and normal
-                    float inv_w0_clip = 1.0f / v0_clip.w;
-                    float inv_w1_clip = 1.0f / v1_clip.w;
-                    float inv_w2_clip = 1.0f / v2_clip.w;
-
-                    float interpolated_inv_w_clip = lambda.x * inv_w0_clip + lambda.y * inv_w1_clip + lambda.z * inv_w2_clip;
-                    if (std::abs(interpolated_inv_w_clip) < std::numeric_limits<float>::epsilon()) continue;
-
-
-                    // Interpolate World Position (P_world / w_clip)
-                    glm::vec3 world_pos_over_w = lambda.x * (v0_world * inv_w0_clip) +
-                        lambda.y * (v1_world * inv_w1_clip) +
-                        lambda.z * (v2_world * inv_w2_clip);
-                    glm::vec3 pixel_world_pos = world_pos_over_w / interpolated_inv_w_clip;
-
-                    // Interpolate World Normal (N_world / w_clip)
-                    glm::vec3 world_normal_over_w = lambda.x * (n0_world_norm * inv_w0_clip) +
-                        lambda.y * (n1_world_norm * inv_w1_clip) +
-                        lambda.z * (n2_world_norm * inv_w2_clip);
-                    glm::vec3 pixel_world_normal_unnormalized = world_normal_over_w / interpolated_inv_w_clip;
-                    glm::vec3 pixel_world_normal_normalized = glm::normalize(pixel_world_normal_unnormalized);
-
+    static void vertex(const glm::vec3& world, const glm::vec3& normal, float* varyings) {
+        for (int k = 0; k < 3; ++k) {
+            varyings[k] = world[k];
+            varyings[3 + k] = normal[k];
+        }
+    }
 
-                    // Calculate pixel color using Phong shading
-                    glm::vec3 pixel_color = calculate_phong_pixel_color(pixel_world_pos, pixel_world_normal_normalized);
+    static void primitive(float*, float*, float*) {}
 
-                    frameBuffer[index * 3 + 0] = static_cast<unsigned char>(pixel_color.r * 255.0f);
-                    frameBuffer[index * 3 + 1] = static_cast<unsigned char>(pixel_color.g * 255.0f);
-                    frameBuffer[index * 3 + 2] = static_cast<unsigned char>(pixel_color.b * 255.0f);
+    static void beginTile(int tile, float nearest_w, float farthest_w) {
+        cullTileLights(tile, nearest_w, farthest_w);
+    }
 
-                    if (!first_pixel_debug_printed && print_debug) { 
-                        std::cout << "    Pixel(" << x << "," << y << "): world_pos(" << pixel_world_pos.x << "," << pixel_world_pos.y << "," << pixel_world_pos.z << ")" << std::endl;
-                        std::cout << "    Pixel(" << x << "," << y << "): world_normal(" << pixel_world_normal_normalized.x << "," << pixel_world_normal_normalized.y << "," << pixel_world_normal_normalized.z << ")" << std::endl;
-                        std::cout << "    Pixel(" << x << "," << y << "): color(" << pixel_color.r << "," << pixel_color.g << "," << pixel_color.b << ")" << std::endl;
-                        first_pixel_debug_printed = true;
-                    }
-                }
+    static void shade(PixelBatch<varyingCount>& batch) {
+        const std::vector<PointLight>& lights = tileLights[batch.tile];
+        lightEvaluations += static_cast<int64_t>(batch.count) * static_cast<int64_t>(lights.size());
+        int i = 0;
+#ifdef RASTER_HAS_SSE2
+        if (useSimdShading) {
+            for (; i < batch.count; i += 4) {
+                shadePhongSse2<Material>(batch, i, lights);
             }
         }
+#endif
+        for (; i < batch.count; ++i) {
+            glm::vec3 color = calculate_phong_pixel_color<Material>(
+                glm::vec3(batch.varyings[0][i], batch.varyings[1][i], batch.varyings[2][i]),
+                glm::normalize(glm::vec3(batch.varyings[3][i], batch.varyings[4][i], batch.varyings[5][i])),
+                lights);
+            batch.color_r[i] = color.r;
+            batch.color_g[i] = color.g;
+            batch.color_b[i] = color.b;
+        }
+        for (i = 0; i < batch.count; ++i) {
+            batch.color_r[i] = encodeGamma(batch.color_r[i]);
+            batch.color_g[i] = encodeGamma(batch.color_g[i]);
+            batch.color_b[i] = encodeGamma(batch.color_b[i]);
+        }
     }
-}
+};
 
+using ActiveShader = PhongShader<SphereMaterial>;
 
 int main() {
     if (!glfwInit()) {
@@ -239,84 +274,49 @@ int main() {
         return -1;
     }
     std::cout << "Scene created: " << gNumVertices << " vertices, " << gNumTriangles << " triangles." << std::endl;
+    VertexStreams vertexStreams = makeVertexStreams();
 
-    std::fill(frameBuffer.begin(), frameBuffer.end(), 0);
-    std::fill(depthBuffer.begin(), depthBuffer.end(), std::numeric_limits<float>::max());
+    clearFrame();
 
     g_modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -7.0f)) *
         glm::scale(glm::mat4(1.0f), glm::vec3(2.0f));
     g_sphere_center_world = glm::vec3(g_modelMatrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
 
-
     glm::mat4 viewMatrix = glm::lookAt(eye_pos_world,
         glm::vec3(0.0f, 0.0f, -1.0f),
         glm::vec3(0.0f, 1.0f, 0.0f));
 
     float nearVal = 0.1f;
     float farVal = 100.0f;
-    glm::mat4 projectionMatrix = glm::frustum(-0.1f, 0.1f, -0.1f, 0.1f, nearVal, farVal);
-
-    glm::mat4 mvpMatrix = projectionMatrix * viewMatrix * g_modelMatrix;
-    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(g_modelMatrix))); // For transforming normals (if model normals were used)
-
-
-    std::cout << "Rasterizing with Phong Shading..." << std::endl;
-    bool first_triangle_main_debug_printed = false;
-
-    for (int i = 0; i < gNumTriangles; ++i) {
-        int k0 = gIndexBuffer[3 * i + 0];
-        int k1 = gIndexBuffer[3 * i + 1];
-        int k2 = gIndexBuffer[3 * i + 2];
-
-        glm::vec3 v0_model = gVertexBuffer[k0];
-        glm::vec3 v1_model = gVertexBuffer[k1];
-        glm::vec3 v2_model = gVertexBuffer[k2];
-
-        // Calculate World Positions
-        glm::vec3 v0_world = glm::vec3(g_modelMatrix * glm::vec4(v0_model, 1.0f));
-        glm::vec3 v1_world = glm::vec3(g_modelMatrix * glm::vec4(v1_model, 1.0f));
-        glm::vec3 v2_world = glm::vec3(g_modelMatrix * glm::vec4(v2_model, 1.0f));
-
-       
-        glm::vec3 n0_world_norm = glm::normalize(v0_world - g_sphere_center_world);
-        glm::vec3 n1_world_norm = glm::normalize(v1_world - g_sphere_center_world);
-        glm::vec3 n2_world_norm = glm::normalize(v2_world - g_sphere_center_world);
-       
-
-        glm::vec4 v0_clip = mvpMatrix * glm::vec4(v0_model, 1.0f);
-        glm::vec4 v1_clip = mvpMatrix * glm::vec4(v1_model, 1.0f);
-        glm::vec4 v2_clip = mvpMatrix * glm::vec4(v2_model, 1.0f);
-
-        bool current_triangle_print_debug = false;
-        if (!first_triangle_main_debug_printed) {
-            std::cout << "Triangle " << i << " Clip Coords (x,y,z,w):" << std::endl;
-            std::cout << "  V0_clip: (" << v0_clip.x << ", " << v0_clip.y << ", " << v0_clip.z << ", " << v0_clip.w << ")" << std::endl;
-       
-            current_triangle_print_debug = true;
-            first_triangle_main_debug_printed = true;
-        }
+    glm::mat4 projectionMatrix = reversedZ ?
+        reversedZFrustum(-0.1f, 0.1f, -0.1f, 0.1f, nearVal, farVal) :
+        glm::frustum(-0.1f, 0.1f, -0.1f, 0.1f, nearVal, farVal);
 
-        rasterizeTriangle(
-            v0_clip, v1_clip, v2_clip,
-            v0_world, v1_world, v2_world,
-            n0_world_norm, n1_world_norm, n2_world_norm,
-            current_triangle_print_debug
-        );
-    }
+    sceneLights = buildSceneLights(g_sphere_center_world);
+    setupLightCulling(projectionMatrix * viewMatrix, nearVal, farVal);
+
+    std::cout << "Rasterizing with " << ActiveShader::name() << " Shading..." << std::endl;
+    drawMesh<ActiveShader>(vertexStreams, viewMatrix, projectionMatrix);
     std::cout << "Rasterization complete." << std::endl;
+    if (printRenderStats) {
+        printFrameStats();
+        if (g_shadingStats.shaded > 0) {
+            std::cout << "Lights: " << sceneLights.size() << " in the scene, "
+                << static_cast<double>(lightEvaluations) / g_shadingStats.shaded << " evaluated per shaded pixel" << std::endl;
+        }
+    }
 
     while (!glfwWindowShouldClose(window)) {
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glDrawPixels(screenWidth, screenHeight, GL_RGB, GL_UNSIGNED_BYTE, frameBuffer.data());
+        presentFrameBuffer();
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-
+    delete_scene();
     glfwDestroyWindow(window);
     glfwTerminate();
 
@@ -0,0 +1,39 @@
+//
+//  lighting.cpp
+//  Material, lights and specular power of the shared scene lighting
+//
+
+#include <limits>
+#include "lighting.h"
+
+const glm::vec3 SphereMaterial::ka = glm::vec3(0.0f, 1.0f, 0.0f);
+const glm::vec3 SphereMaterial::kd = glm::vec3(0.0f, 0.5f, 0.0f);
+const glm::vec3 SphereMaterial::ks = glm::vec3(0.5f, 0.5f, 0.5f);
+
+std::vector<PointLight> sceneLights;
+
+std::vector<PointLight> buildSceneLights(const glm::vec3& sphere_center) {
+    std::vector<PointLight> lights;
+    lights.push_back({ light_pos_world, light_Il_intensity, std::numeric_limits<float>::infinity() });
+
+    // Fibonacci sphere: equal-area bands in z, consecutive lights a golden angle apart
+    const float golden_angle = 2.39996323f;
+    for (int i = 0; i < extraLightCount; ++i) {
+        float z = 1.0f - 2.0f * (static_cast<float>(i) + 0.5f) / static_cast<float>(extraLightCount);
+        float ring = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        float angle = golden_angle * static_cast<float>(i);
+        glm::vec3 direction(ring * std::cos(angle), ring * std::sin(angle), z);
+        glm::vec3 hue(
+            0.5f + 0.5f * std::cos(angle),
+            0.5f + 0.5f * std::cos(angle + 2.09439510f),
+            0.5f + 0.5f * std::cos(angle + 4.18879020f));
+        lights.push_back({ sphere_center + direction * extraLightShellRadius, hue * extraLightIntensity, extraLightRadius });
+    }
+    return lights;
+}
+
+float lightFalloff(float distance_sq, float radius) {
+    float t = distance_sq / (radius * radius);
+    float window = std::max(0.0f, 1.0f - t * t);
+    return window * window;
+}
@@ -0,0 +1,149 @@
+#pragma once
+#ifndef LIGHTING_H
+#define LIGHTING_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "rasterizer.h"
+
+// Scene lighting shared by the Q1, Q2 and Q3 viewers: the sphere's material, the point lights,
+// the specular power and the Phong reflection model.
+
+// Material of the shader policies: ambient, diffuse and specular reflectance and the specular
+// exponent. The shaders are templates on it, so another material is another struct like this one.
+struct SphereMaterial {
+    static const glm::vec3 ka;
+    static const glm::vec3 kd;
+    static const glm::vec3 ks;
+    static constexpr float shininess = 32.0f;
+};
+
+const float light_Ia_intensity = 0.2f;
+const glm::vec3 light_pos_world = glm::vec3(-4.0f, 4.0f, -3.0f);
+const glm::vec3 light_Il_intensity = glm::vec3(1.0f, 1.0f, 1.0f); // White light
+
+// A point light reaches the points within radius of its position. Its intensity is scaled by
+// lightFalloff, which fades from 1 at the light to 0 at the radius; an infinite radius, as the
+// assignment's light has, is never attenuated or culled.
+struct PointLight {
+    glm::vec3 position;
+    glm::vec3 intensity;
+    float radius;
+};
+
+// Extra lights of extraLightRadius spread evenly over a shell around the sphere, for scenes with
+// many local lights; 0 renders the assignment's single light
+const int extraLightCount = 0;
+const float extraLightRadius = 1.5f;
+const float extraLightShellRadius = 2.5f;
+const float extraLightIntensity = 0.4f;
+
+extern std::vector<PointLight> sceneLights; // built by buildSceneLights once the sphere is placed
+
+std::vector<PointLight> buildSceneLights(const glm::vec3& sphere_center);
+
+// (1 - (d / radius)^4)^2 for a point at squared distance d^2 from a light
+float lightFalloff(float distance_sq, float radius);
+
+const glm::vec3 eye_pos_world = glm::vec3(0.0f, 0.0f, 0.0f);
+
+// Specular power, per material. A whole-number shininess is expanded at compile time into
+// repeated squaring (IntegerPower); any other shininess reads specularTable, x^shininess sampled
+// at specularTableSize + 1 uniform points of [0, 1] and interpolated linearly. For shininess >= 2
+// the table error is at most shininess * (shininess - 1) / (8 * specularTableSize^2) plus float
+// rounding: 7.6e-6 at 32.5, 1.2e-4 at 128.5.
+const bool useFastSpecularPower = true;
+const int specularTableSize = 4096;
+template <typename Material>
+constexpr bool specularShininessIsInteger = Material::shininess >= 0.0f && Material::shininess == static_cast<float>(static_cast<int>(Material::shininess));
+
+// x^N with log2(N) squarings and one multiply per set bit of N, unrolled at compile time
+template <int N>
+struct IntegerPower {
+    static float eval(float x) {
+        float half = IntegerPower<N / 2>::eval(x);
+        return N % 2 != 0 ? half * half * x : half * half;
+    }
+#ifdef RASTER_HAS_SSE2
+    static __m128 eval(__m128 x) {
+        __m128 half = IntegerPower<N / 2>::eval(x);
+        __m128 square = _mm_mul_ps(half, half);
+        return N % 2 != 0 ? _mm_mul_ps(square, x) : square;
+    }
+#endif
+};
+
+template <>
+struct IntegerPower<0> {
+    static float eval(float) {
+        return 1.0f;
+    }
+#ifdef RASTER_HAS_SSE2
+    static __m128 eval(__m128) {
+        return _mm_set1_ps(1.0f);
+    }
+#endif
+};
+
+template <typename Material>
+std::vector<float> buildSpecularTable() {
+    std::vector<float> table;
+    if (!specularShininessIsInteger<Material>) {
+        table.resize(specularTableSize + 1);
+        for (int i = 0; i <= specularTableSize; ++i) {
+            table[i] = static_cast<float>(std::pow(static_cast<double>(i) / specularTableSize, static_cast<double>(Material::shininess)));
+        }
+    }
+    return table;
+}
+template <typename Material>
+const std::vector<float> specularTable = buildSpecularTable<Material>();
+
+// x^Material::shininess for x in [0, 1]
+template <typename Material>
+float specularPower(float x) {
+    if (!useFastSpecularPower) {
+        return std::pow(x, Material::shininess);
+    }
+    if (specularShininessIsInteger<Material>) {
+        return IntegerPower<specularShininessIsInteger<Material> ? static_cast<int>(Material::shininess) : 0>::eval(x);
+    }
+    const std::vector<float>& table = specularTable<Material>;
+    float scaled = std::min(std::max(0.0f, x), 1.0f) * specularTableSize;
+    int i = std::min(static_cast<int>(scaled), specularTableSize - 1);
+    return table[i] + (table[i + 1] - table[i]) * (scaled - static_cast<float>(i));
+}
+
+// Linear Phong color clamped to [0, 1] at a surface point with a unit normal, lit by the given
+// lights
+template <typename Material>
+glm::vec3 calculate_phong_pixel_color(const glm::vec3& pixel_world_pos, const glm::vec3& pixel_world_normal_normalized,
+    const std::vector<PointLight>& lights) {
+    // Ambient
+    glm::vec3 final_color_linear = light_Ia_intensity * Material::ka;
+    glm::vec3 view_dir = glm::normalize(eye_pos_world - pixel_world_pos);
+
+    for (const PointLight& light : lights) {
+        glm::vec3 to_light = light.position - pixel_world_pos;
+        float falloff = lightFalloff(glm::dot(to_light, to_light), light.radius);
+        if (falloff <= 0.0f) {
+            continue;
+        }
+        glm::vec3 radiance = light.intensity * falloff;
+
+        // Diffuse
+        glm::vec3 light_dir = glm::normalize(to_light);
+        float diff_factor = std::max(0.0f, glm::dot(pixel_world_normal_normalized, light_dir));
+        final_color_linear += radiance * Material::kd * diff_factor;
+
+        // Specular
+        glm::vec3 reflect_dir = glm::reflect(-light_dir, pixel_world_normal_normalized);
+        float spec_factor = specularPower<Material>(std::max(0.0f, glm::dot(view_dir, reflect_dir)));
+        final_color_linear += radiance * Material::ks * spec_factor;
+    }
+    return glm::clamp(final_color_linear, 0.0f, 1.0f);
+}
+
+#endif // LIGHTING_H
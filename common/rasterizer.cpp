@@ -0,0 +1,264 @@
+//
+//  rasterizer.cpp
+//  Frame and depth buffers, color output, clipping and culling of the software rasterizer
+//
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+#include "rasterizer.h"
+
+std::vector<unsigned char> frameBuffer(screenWidth* screenHeight * 3);
+
+std::vector<float> depthBuffer(depthIsFloat ? screenWidth * screenHeight : 0);
+std::vector<uint16_t> depthBuffer16(depthFormat == DepthFormat::Unorm16 ? screenWidth * screenHeight : 0);
+std::vector<uint32_t> depthBuffer24(depthFormat == DepthFormat::Unorm24 ? screenWidth * screenHeight : 0);
+
+uint32_t encodeUnormDepth(float z_window, uint32_t max_code) {
+    float code = std::max(z_window, 0.0f) * static_cast<float>(max_code) + 0.5f;
+    return static_cast<uint32_t>(std::min(code, static_cast<float>(max_code)));
+}
+
+void clearDepthBuffer() {
+    std::fill(depthBuffer.begin(), depthBuffer.end(),
+        reversedZ ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max());
+    std::fill(depthBuffer16.begin(), depthBuffer16.end(), static_cast<uint16_t>(depthUnorm16Max));
+    std::fill(depthBuffer24.begin(), depthBuffer24.end(), depthUnorm24Max);
+}
+
+bool depthTestAndWrite(int index, float z_ndc) {
+    switch (depthFormat) {
+    case DepthFormat::Unorm16: {
+        uint16_t code = static_cast<uint16_t>(encodeUnormDepth((z_ndc + 1.0f) * 0.5f, depthUnorm16Max));
+        if (code < depthBuffer16[index]) {
+            depthBuffer16[index] = code;
+            return true;
+        }
+        return false;
+    }
+    case DepthFormat::Unorm24: {
+        uint32_t code = encodeUnormDepth((z_ndc + 1.0f) * 0.5f, depthUnorm24Max);
+        if (code < depthBuffer24[index]) {
+            depthBuffer24[index] = code;
+            return true;
+        }
+        return false;
+    }
+    case DepthFormat::Float32ReversedZ:
+        if (z_ndc > depthBuffer[index]) {
+            depthBuffer[index] = z_ndc;
+            return true;
+        }
+        return false;
+    default: {
+        float z_screen = (z_ndc + 1.0f) * 0.5f;
+        if (z_screen < depthBuffer[index]) {
+            depthBuffer[index] = z_screen;
+            return true;
+        }
+        return false;
+    }
+    }
+}
+
+void storeDepth(int index, float z_ndc) {
+    switch (depthFormat) {
+    case DepthFormat::Unorm16:
+        depthBuffer16[index] = static_cast<uint16_t>(encodeUnormDepth((z_ndc + 1.0f) * 0.5f, depthUnorm16Max));
+        break;
+    case DepthFormat::Unorm24:
+        depthBuffer24[index] = encodeUnormDepth((z_ndc + 1.0f) * 0.5f, depthUnorm24Max);
+        break;
+    case DepthFormat::Float32ReversedZ:
+        depthBuffer[index] = z_ndc;
+        break;
+    default:
+        depthBuffer[index] = (z_ndc + 1.0f) * 0.5f;
+        break;
+    }
+}
+
+void clearDepthPixel(int index) {
+    switch (depthFormat) {
+    case DepthFormat::Unorm16:
+        depthBuffer16[index] = static_cast<uint16_t>(depthUnorm16Max);
+        break;
+    case DepthFormat::Unorm24:
+        depthBuffer24[index] = depthUnorm24Max;
+        break;
+    default:
+        depthBuffer[index] = reversedZ ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max();
+        break;
+    }
+}
+
+glm::mat4 reversedZFrustum(float left, float right, float bottom, float top, float nearVal, float farVal) {
+    glm::mat4 m = glm::frustum(left, right, bottom, top, nearVal, farVal);
+    m[2][2] = nearVal / (farVal - nearVal);
+    m[3][2] = nearVal * farVal / (farVal - nearVal);
+    return m;
+}
+
+float storedDepthDistance(int index) {
+    switch (depthFormat) {
+    case DepthFormat::Unorm16:
+        return depthBuffer16[index] / static_cast<float>(depthUnorm16Max);
+    case DepthFormat::Unorm24:
+        return depthBuffer24[index] / static_cast<float>(depthUnorm24Max);
+    case DepthFormat::Float32ReversedZ:
+        return 1.0f - depthBuffer[index];
+    default:
+        return depthBuffer[index];
+    }
+}
+
+float depthDistance(float z_ndc) {
+    return reversedZ ? 1.0f - z_ndc : (z_ndc + 1.0f) * 0.5f;
+}
+
+std::vector<GammaSegment> buildGammaTable(float gamma) {
+    const int segments_per_octave = 1 << gammaTableMantissaBits;
+    std::vector<GammaSegment> table(gammaTableOctaves * segments_per_octave);
+    for (int i = 0; i < static_cast<int>(table.size()); ++i) {
+        double octave = std::ldexp(1.0, i / segments_per_octave - gammaTableOctaves);
+        double x0 = octave * (1.0 + static_cast<double>(i % segments_per_octave) / segments_per_octave);
+        double x1 = octave * (1.0 + static_cast<double>(i % segments_per_octave + 1) / segments_per_octave);
+        double y0 = std::pow(x0, 1.0 / gamma);
+        double y1 = std::pow(x1, 1.0 / gamma);
+        table[i] = { static_cast<float>(x0), static_cast<float>(y0), static_cast<float>((y1 - y0) / (x1 - x0)) };
+    }
+    return table;
+}
+
+const std::vector<GammaSegment> gammaTable = buildGammaTable(gamma_val);
+
+float encodeGamma(float linear) {
+    if (!useGammaTable) {
+        return std::pow(std::max(0.0f, linear), 1.0f / gamma_val);
+    }
+    if (!(linear >= gammaTable[0].start)) {
+        return 0.0f;
+    }
+    if (linear >= 1.0f) {
+        return 1.0f;
+    }
+    uint32_t bits;
+    std::memcpy(&bits, &linear, sizeof(bits));
+    const GammaSegment& segment = gammaTable[(bits >> (23 - gammaTableMantissaBits)) - gammaTableFirstCode];
+    return segment.encoded + segment.slope * (linear - segment.start);
+}
+
+// Difference between encodeGamma and std::pow at one input, in 8-bit output steps
+static double gammaTableErrorAt(float linear) {
+    double exact = std::pow(static_cast<double>(linear), 1.0 / gamma_val);
+    return std::abs(encodeGamma(linear) - exact) * 255.0;
+}
+
+float measureGammaTableError(int float_stride) {
+    double max_error = 0.0;
+    for (size_t i = 0; i < gammaTable.size(); ++i) {
+        max_error = std::max(max_error, gammaTableErrorAt(gammaTable[i].start));
+        if (i > 0) {
+            max_error = std::max(max_error, gammaTableErrorAt(std::nextafter(gammaTable[i].start, 0.0f)));
+        }
+    }
+    const float first = gammaTable[0].start;
+    const float one = 1.0f;
+    uint32_t first_bits;
+    uint32_t one_bits;
+    std::memcpy(&first_bits, &first, sizeof(first_bits));
+    std::memcpy(&one_bits, &one, sizeof(one_bits));
+    for (uint32_t bits = first_bits; bits <= one_bits; bits += float_stride) {
+        float linear;
+        std::memcpy(&linear, &bits, sizeof(linear));
+        max_error = std::max(max_error, gammaTableErrorAt(linear));
+    }
+    return static_cast<float>(max_error);
+}
+
+#ifndef NDEBUG
+static float checkGammaTable() {
+    float error = measureGammaTableError(61);
+    assert(error < gammaTableTolerance && "gammaTable drifted from std::pow");
+    return error;
+}
+
+// Runs after gammaTable, which is defined above in this translation unit
+static const float gammaTableStartupError = checkGammaTable();
+#endif
+
+unsigned char quantizeUnorm8(float encoded) {
+    return static_cast<unsigned char>(std::min(std::max(0.0f, encoded), 1.0f) * 255.0f + 0.5f);
+}
+
+CullStats g_cullStats;
+
+bool passesFaceCull(float area, CullStats* stats) {
+    if (std::abs(area) < std::numeric_limits<float>::epsilon()) {
+        if (stats) ++stats->degenerate;
+        return false;
+    }
+
+    bool front_facing = (frontFace == FrontFace::CounterClockwise) ? area > 0.0f : area < 0.0f;
+    if ((cullMode == CullMode::Back && !front_facing) || (cullMode == CullMode::Front && front_facing)) {
+        if (stats) ++stats->face;
+        return false;
+    }
+    return true;
+}
+
+ModelSpaceView makeModelSpaceView(const glm::mat4& mvpMatrix, const glm::mat4& modelViewMatrix) {
+    ModelSpaceView view;
+    // dot(plane, mvp * p) == dot(transpose(mvp) * plane, p)
+    glm::mat4 mvp_transposed = glm::transpose(mvpMatrix);
+    for (int p = 0; p < clipPlaneCount; ++p) {
+        glm::vec4 plane = mvp_transposed * clipPlanes[p];
+        view.frustum_planes[p] = plane / glm::length(glm::vec3(plane));
+    }
+    view.eye = glm::vec3(glm::inverse(modelViewMatrix) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    return view;
+}
+
+bool isMeshletVisible(const Meshlet& meshlet, const ModelSpaceView& view, CullStats* stats) {
+    for (int p = 0; p < clipPlaneCount; ++p) {
+        const glm::vec4& plane = view.frustum_planes[p];
+        if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius) {
+            if (stats) ++stats->meshlet_frustum;
+            return false;
+        }
+    }
+
+    const float half_pi = 1.57079632679f;
+    if (cullMode == CullMode::None || meshlet.coneAngle >= half_pi) {
+        return true;
+    }
+
+    // A triangle is front facing when its front normal points at the eye. The cone holds the
+    // counterclockwise normals; turn it toward the normals of the faces cullMode removes.
+    glm::vec3 axis = meshlet.coneAxis;
+    if (frontFace == FrontFace::Clockwise) {
+        axis = -axis;
+    }
+    if (cullMode == CullMode::Front) {
+        axis = -axis;
+    }
+
+    // Every face is culled when each culled-side normal is within 90 degrees of every view ray
+    // into the sphere: the cone's spread, plus the sphere's angular radius, plus the angle
+    // between the axis and the ray to the center must stay below 90 degrees.
+    glm::vec3 to_center = meshlet.center - view.eye;
+    float distance = glm::length(to_center);
+    if (distance <= meshlet.radius) {
+        return true;
+    }
+    float view_spread = std::asin(meshlet.radius / distance);
+    float axis_angle = std::acos(glm::clamp(glm::dot(axis, to_center / distance), -1.0f, 1.0f));
+    if (axis_angle + meshlet.coneAngle + view_spread < half_pi) {
+        if (stats) ++stats->meshlet_cone;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,295 @@
+#pragma once
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "sphere_scene.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Software rasterizer shared by the Q1, Q2 and Q3 viewers: frame and depth buffers, color output,
+// clipping and culling.
+
+const int screenWidth = 512;
+const int screenHeight = 512;
+
+extern std::vector<unsigned char> frameBuffer;
+
+// Depth buffer storage format. Every format keeps the nearer fragment; on a tie the stored one
+// stays.
+enum class DepthFormat {
+    Unorm16,         // (z_ndc + 1) / 2 as 16-bit fixed point, half the depth traffic of float
+    Unorm24,         // (z_ndc + 1) / 2 as 24-bit fixed point in the low bits of a 32-bit word
+    Float32,         // (z_ndc + 1) / 2 as float
+    Float32ReversedZ // z_ndc of a reversed-Z projection as float: 1 at the near plane, 0 at the
+                     // far plane, so float precision is densest where perspective depth is coarsest
+};
+const DepthFormat depthFormat = DepthFormat::Float32;
+const bool reversedZ = depthFormat == DepthFormat::Float32ReversedZ;
+const uint32_t depthUnorm16Max = 0xffff;
+const uint32_t depthUnorm24Max = 0xffffff;
+
+// Only the buffer of the selected format is allocated
+const bool depthIsFloat = depthFormat == DepthFormat::Float32 || reversedZ;
+extern std::vector<float> depthBuffer;
+extern std::vector<uint16_t> depthBuffer16;
+extern std::vector<uint32_t> depthBuffer24;
+
+// Fixed-point code of a window depth, clamped to [0, 1] and rounded to nearest
+uint32_t encodeUnormDepth(float z_window, uint32_t max_code);
+
+// The float formats are cleared past the far plane, the fixed-point ones to it
+void clearDepthBuffer();
+
+// Depth test and write of a fragment at z_ndc; true when it is nearer than the stored depth
+bool depthTestAndWrite(int index, float z_ndc);
+
+// Stores a fragment at z_ndc without a test, with the arithmetic of depthTestAndWrite
+void storeDepth(int index, float z_ndc);
+
+// Stores the value clearDepthBuffer writes
+void clearDepthPixel(int index);
+
+// glm::frustum with the depth range reversed onto [0, 1]: z_ndc is 1 at the near plane and 0 at
+// the far plane. The two depth terms are written directly; remapping the [-1, 1] matrix would
+// cancel away the precision reversed Z is meant to keep.
+glm::mat4 reversedZFrustum(float left, float right, float bottom, float top, float nearVal, float farVal);
+
+// Stored depth as a distance that grows away from the eye, in [0, 1] for every format (cleared
+// float pixels read FLT_MAX); the hierarchical Z tests work in this space.
+float storedDepthDistance(int index);
+
+// Distance of a fragment at z_ndc, in the space of storedDepthDistance
+float depthDistance(float z_ndc);
+
+// Valid z_ndc range is [depthNdcMin, 1]
+const float depthNdcMin = reversedZ ? 0.0f : -1.0f;
+
+const float gamma_val = 2.2f;
+
+// Color output: linear channels are gamma-encoded through gammaTable instead of std::pow and
+// rounded to the nearest 8-bit value. The table splits [2^-gammaTableOctaves, 1) into octaves by
+// float exponent and each octave into 2^gammaTableMantissaBits segments by the leading mantissa
+// bits; a segment interpolates linearly between exact end points. For gamma 2.2 the error is
+// below 0.006 of an output step over every float in [0, 1] (640 entries). Inputs under the first
+// octave encode below half a step and round to 0. The table therefore changes a quantized channel
+// only where std::pow lands within 0.006 of a rounding tie; rounding to nearest instead of
+// truncating is what moves most pixels by one code relative to the original output.
+const bool useGammaTable = true;
+const int gammaTableOctaves = 20;
+const int gammaTableMantissaBits = 5;
+// Float bits >> (23 - gammaTableMantissaBits) of 2^-gammaTableOctaves, the first table entry
+const uint32_t gammaTableFirstCode = static_cast<uint32_t>(127 - gammaTableOctaves) << gammaTableMantissaBits;
+
+struct GammaSegment {
+    float start;   // linear value where the segment begins
+    float encoded; // encoded value at start
+    float slope;   // encoded change per linear unit up to the next segment
+};
+
+extern const std::vector<GammaSegment> gammaTable;
+
+// Largest allowed difference between the table and std::pow, in 8-bit output steps
+const float gammaTableTolerance = 0.006f;
+
+// Gamma-encodes one linear channel value; inputs are expected in [0, 1]
+float encodeGamma(float linear);
+
+// Largest difference between encodeGamma and std::pow, in 8-bit output steps, over every
+// float_stride-th float in [0, 1] and every segment end point. Debug builds check it against
+// gammaTableTolerance at startup.
+float measureGammaTableError(int float_stride);
+
+// Rounds an encoded channel to the nearest 8-bit value
+unsigned char quantizeUnorm8(float encoded);
+
+// Face culling. Winding follows glFrontFace and is judged in NDC (y up); sphere_scene winds
+// the outside of the sphere counterclockwise.
+enum class CullMode { None, Back, Front };
+enum class FrontFace { CounterClockwise, Clockwise };
+const CullMode cullMode = CullMode::Back;
+const FrontFace frontFace = FrontFace::CounterClockwise;
+
+// Number of triangles (meshlets for the meshlet_ fields) rejected by each stage before
+// rasterization, reported after the frame
+struct CullStats {
+    int projection = 0; // a vertex with |w| too small to project, or all vertices behind the eye
+    int degenerate = 0; // zero screen-space area
+    int face = 0;       // removed by cullMode
+    int clipped = 0;    // entirely outside a clip plane
+    int meshlet_frustum = 0;  // bounding sphere outside the view frustum
+    int meshlet_cone = 0;     // normal cone shows every triangle would be face culled
+    int meshlet_occluded = 0; // bounding box behind the hierarchical Z buffer
+};
+extern CullStats g_cullStats;
+
+// Rejects degenerate triangles and the faces selected by cullMode, given the screen-space
+// edgeFunction area. The screen is y down, so a positive area is counterclockwise in NDC.
+bool passesFaceCull(float area, CullStats* stats);
+
+// Clipping in homogeneous clip space, before the divide by w. A vertex is inside a plane when
+// dot(plane, v_clip) >= 0. The near plane (z >= -w, or z <= w with reversed Z) is always clipped, which keeps w positive
+// for everything that reaches the rasterizer. Triangles entirely outside any frustum plane are
+// rejected. With clipAllFrustumPlanes the other five planes are clipped exactly; otherwise x and
+// y are only clipped against the guard band and the bounding-box clamp handles the screen edge.
+const bool clipAllFrustumPlanes = false;
+const int clipPlaneCount = 6;
+const glm::vec4 clipPlanes[clipPlaneCount] = {
+    reversedZ ? glm::vec4(0.0f, 0.0f, -1.0f, 1.0f) : glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), // near
+    reversedZ ? glm::vec4(0.0f, 0.0f, 1.0f, 0.0f) : glm::vec4(0.0f, 0.0f, -1.0f, 1.0f), // far
+    glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),  // left
+    glm::vec4(-1.0f, 0.0f, 0.0f, 1.0f), // right
+    glm::vec4(0.0f, 1.0f, 0.0f, 1.0f),  // bottom
+    glm::vec4(0.0f, -1.0f, 0.0f, 1.0f)  // top
+};
+// Guard-band half extent in NDC units (1 = the viewport). Screen coordinates inside it stay
+// well within subpixelRangeLimit, so the fixed-point path handles them without clipping.
+const float guardBandExtent = 16.0f;
+const int guardBandPlaneCount = 4;
+const glm::vec4 guardBandPlanes[guardBandPlaneCount] = {
+    glm::vec4(1.0f, 0.0f, 0.0f, guardBandExtent),  // left
+    glm::vec4(-1.0f, 0.0f, 0.0f, guardBandExtent), // right
+    glm::vec4(0.0f, 1.0f, 0.0f, guardBandExtent),  // bottom
+    glm::vec4(0.0f, -1.0f, 0.0f, guardBandExtent)  // top
+};
+// Every plane can add at most one vertex to a convex polygon
+const int maxClipVertices = 3 + clipPlaneCount;
+
+// Post-transform triangle as handed from the geometry loop to the tile workers, with the
+// varyings of the shader that draws it
+template <int VaryingCount>
+struct ClipTriangle {
+    glm::vec4 v_clip[3];
+    float varyings[3][VaryingCount];
+};
+
+// Shaded vertex, and polygon vertex during clipping; all attributes are interpolated linearly in
+// clip space
+template <int VaryingCount>
+struct ClipVertex {
+    glm::vec4 v_clip;
+    float varyings[VaryingCount];
+};
+
+template <int VaryingCount>
+ClipVertex<VaryingCount> lerpClipVertex(const ClipVertex<VaryingCount>& a, const ClipVertex<VaryingCount>& b, float t) {
+    ClipVertex<VaryingCount> v;
+    v.v_clip = a.v_clip + (b.v_clip - a.v_clip) * t;
+    for (int k = 0; k < VaryingCount; ++k) {
+        v.varyings[k] = a.varyings[k] + (b.varyings[k] - a.varyings[k]) * t;
+    }
+    return v;
+}
+
+template <int VaryingCount>
+ClipTriangle<VaryingCount> makeClipTriangle(const ClipVertex<VaryingCount>& a, const ClipVertex<VaryingCount>& b, const ClipVertex<VaryingCount>& c) {
+    ClipTriangle<VaryingCount> tri;
+    const ClipVertex<VaryingCount>* corners[3] = { &a, &b, &c };
+    for (int i = 0; i < 3; ++i) {
+        tri.v_clip[i] = corners[i]->v_clip;
+        std::copy(corners[i]->varyings, corners[i]->varyings + VaryingCount, tri.varyings[i]);
+    }
+    return tri;
+}
+
+// One Sutherland-Hodgman pass: clips the convex polygon against a single plane in place and
+// returns the new vertex count.
+template <int VaryingCount>
+int clipPolygonAgainstPlane(ClipVertex<VaryingCount>* polygon, int count, const glm::vec4& plane) {
+    ClipVertex<VaryingCount> input[maxClipVertices];
+    std::copy(polygon, polygon + count, input);
+
+    int out_count = 0;
+    for (int i = 0; i < count; ++i) {
+        const ClipVertex<VaryingCount>& a = input[i];
+        const ClipVertex<VaryingCount>& b = input[(i + 1) % count];
+        float d_a = glm::dot(plane, a.v_clip);
+        float d_b = glm::dot(plane, b.v_clip);
+
+        if (d_a >= 0.0f) {
+            polygon[out_count++] = a;
+        }
+        if ((d_a >= 0.0f) != (d_b >= 0.0f)) {
+            polygon[out_count++] = lerpClipVertex(a, b, d_a / (d_a - d_b));
+        }
+    }
+    return out_count;
+}
+
+// Clips the triangle in polygon[0..2] against the active planes. Returns the vertex count of
+// the resulting convex polygon (0 when nothing is left), wound like the input triangle.
+template <int VaryingCount>
+int clipTriangle(ClipVertex<VaryingCount> polygon[maxClipVertices], CullStats* stats) {
+    // Outcodes first: bits 0-5 for the frustum planes, bits 6-9 for the guard band. Almost every
+    // triangle is entirely inside the guard band or entirely outside some frustum plane.
+    const int frustum_mask = (1 << clipPlaneCount) - 1;
+    int outside_any = 0;
+    int outside_all = ~0;
+    for (int i = 0; i < 3; ++i) {
+        int outcode = 0;
+        for (int p = 0; p < clipPlaneCount; ++p) {
+            if (glm::dot(clipPlanes[p], polygon[i].v_clip) < 0.0f) {
+                outcode |= 1 << p;
+            }
+        }
+        for (int p = 0; p < guardBandPlaneCount; ++p) {
+            if (glm::dot(guardBandPlanes[p], polygon[i].v_clip) < 0.0f) {
+                outcode |= 1 << (clipPlaneCount + p);
+            }
+        }
+        outside_any |= outcode;
+        outside_all &= outcode;
+    }
+    if (outside_all & frustum_mask) {
+        if (stats) ++stats->clipped;
+        return 0;
+    }
+
+    int count = 3;
+    if (outside_any & 1) {
+        count = clipPolygonAgainstPlane(polygon, count, clipPlanes[0]);
+    }
+    if (clipAllFrustumPlanes) {
+        for (int p = 1; p < clipPlaneCount && count >= 3; ++p) {
+            if (outside_any & (1 << p)) {
+                count = clipPolygonAgainstPlane(polygon, count, clipPlanes[p]);
+            }
+        }
+    }
+    else {
+        for (int p = 0; p < guardBandPlaneCount && count >= 3; ++p) {
+            if (outside_any & (1 << (clipPlaneCount + p))) {
+                count = clipPolygonAgainstPlane(polygon, count, guardBandPlanes[p]);
+            }
+        }
+    }
+    if (count < 3) {
+        if (stats) ++stats->clipped;
+        return 0;
+    }
+    return count;
+}
+
+// Meshlet culling: a whole meshlet is skipped before its triangles are assembled when its
+// bounding sphere is outside the view frustum or, while cullMode removes faces, its normal cone
+// shows that every one of its triangles would be culled.
+const bool useMeshletCulling = true;
+
+// The camera in the mesh's model space, where meshlet bounds live
+struct ModelSpaceView {
+    glm::vec4 frustum_planes[clipPlaneCount]; // normalized: dot(xyz, p) + w is a signed distance
+    glm::vec3 eye;
+};
+
+ModelSpaceView makeModelSpaceView(const glm::mat4& mvpMatrix, const glm::mat4& modelViewMatrix);
+
+// False when the whole meshlet can be skipped; the rejecting test is counted.
+bool isMeshletVisible(const Meshlet& meshlet, const ModelSpaceView& view, CullStats* stats);
+
+#endif // RASTERIZER_H
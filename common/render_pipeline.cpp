@@ -0,0 +1,538 @@
+//
+//  render_pipeline.cpp
+//  Rasterization, depth, visibility buffer and tiled backend of the shared rendering pipeline
+//
+
+#include <GL/glew.h>
+#include <iostream>
+#include "render_pipeline.h"
+
+glm::mat4 g_modelMatrix;
+glm::vec3 g_sphere_center_world;
+ShadingStats g_shadingStats;
+
+std::vector<float> hiZBuffer(hiZWidth * hiZHeight);
+std::vector<int> visibilityBuffer(screenWidth * screenHeight);
+std::vector<uint8_t> tileCleared(tileCountX * tileCountY);
+
+ScreenRect tileRect(int tile) {
+    int tx = tile % tileCountX;
+    int ty = tile / tileCountX;
+    ScreenRect rect = {
+        tx * tileSize, ty * tileSize,
+        std::min((tx + 1) * tileSize, screenWidth) - 1, std::min((ty + 1) * tileSize, screenHeight) - 1
+    };
+    return rect;
+}
+
+void clearFrame() {
+    if (useCompressedDepth) {
+        resetDepthBlocks();
+    }
+    std::fill(hiZBuffer.begin(), hiZBuffer.end(), std::numeric_limits<float>::max());
+    if (useLazyClear) {
+        std::fill(tileCleared.begin(), tileCleared.end(), static_cast<uint8_t>(1));
+        return;
+    }
+    std::fill(frameBuffer.begin(), frameBuffer.end(), 0);
+    std::fill(visibilityBuffer.begin(), visibilityBuffer.end(), emptyVisibilityId);
+    if (!useCompressedDepth) {
+        clearDepthBuffer();
+    }
+}
+
+void clearTilesOnFirstWrite(int x0, int y0, int x1, int y1) {
+    if (!useLazyClear || x0 > x1 || y0 > y1) {
+        return;
+    }
+    for (int ty = y0 / tileSize; ty <= y1 / tileSize; ++ty) {
+        for (int tx = x0 / tileSize; tx <= x1 / tileSize; ++tx) {
+            int tile = ty * tileCountX + tx;
+            if (!tileCleared[tile]) {
+                continue;
+            }
+            ScreenRect rect = tileRect(tile);
+            for (int y = rect.minY; y <= rect.maxY; ++y) {
+                int row = y * screenWidth;
+                std::fill(frameBuffer.begin() + 3 * (row + rect.minX), frameBuffer.begin() + 3 * (row + rect.maxX + 1), 0);
+                std::fill(visibilityBuffer.begin() + row + rect.minX, visibilityBuffer.begin() + row + rect.maxX + 1, emptyVisibilityId);
+                if (!useCompressedDepth) {
+                    for (int x = rect.minX; x <= rect.maxX; ++x) {
+                        clearDepthPixel(row + x);
+                    }
+                }
+            }
+            tileCleared[tile] = 0;
+        }
+    }
+}
+
+bool isTileCleared(int index) {
+    return useLazyClear && tileCleared[(index / screenWidth / tileSize) * tileCountX + (index % screenWidth) / tileSize] != 0;
+}
+
+int tileAt(int x, int y) {
+    return (y / tileSize) * tileCountX + x / tileSize;
+}
+
+float edgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+    return (c.x - a.x) * (b.y - a.y) - (c.y - a.y) * (b.x - a.x);
+}
+
+bool passesProjectionTest(const glm::vec4& v0_clip, const glm::vec4& v1_clip, const glm::vec4& v2_clip, CullStats* stats) {
+    const float epsilon_w = 1e-5f;
+    if ((v0_clip.w < epsilon_w && v1_clip.w < epsilon_w && v2_clip.w < epsilon_w) ||
+        std::abs(v0_clip.w) < epsilon_w || std::abs(v1_clip.w) < epsilon_w || std::abs(v2_clip.w) < epsilon_w) {
+        if (stats) ++stats->projection;
+        return false;
+    }
+    return true;
+}
+
+glm::vec2 clipToScreen(const glm::vec4& v_clip) {
+    glm::vec3 v_ndc = glm::vec3(v_clip) / v_clip.w;
+    return glm::vec2((v_ndc.x + 1.0f) * 0.5f * screenWidth, (1.0f - v_ndc.y) * 0.5f * screenHeight);
+}
+
+bool isSubpixelRepresentable(const glm::vec2& v0, const glm::vec2& v1, const glm::vec2& v2) {
+    return std::max({ std::abs(v0.x), std::abs(v0.y), std::abs(v1.x), std::abs(v1.y), std::abs(v2.x), std::abs(v2.y) }) < subpixelRangeLimit;
+}
+
+glm::ivec2 snapToSubpixel(const glm::vec2& v) {
+    return glm::ivec2(static_cast<int>(std::floor(v.x * subpixelScale + 0.5f)),
+        static_cast<int>(std::floor(v.y * subpixelScale + 0.5f)));
+}
+
+AttributePlane setupPlane(const glm::vec2& v0, const glm::vec2& v1, const glm::vec2& v2, float a0, float a1, float a2) {
+    glm::vec2 d1 = v1 - v0;
+    glm::vec2 d2 = v2 - v0;
+    float inv_det = 1.0f / (d1.x * d2.y - d2.x * d1.y);
+
+    AttributePlane plane;
+    plane.dx = ((a1 - a0) * d2.y - (a2 - a0) * d1.y) * inv_det;
+    plane.dy = ((a2 - a0) * d1.x - (a1 - a0) * d2.x) * inv_det;
+    plane.c = a0 - plane.dx * v0.x - plane.dy * v0.y;
+    return plane;
+}
+
+void writePixelColor(int x, int y, const glm::vec3& color) {
+    int index = y * screenWidth + x;
+    frameBuffer[index * 3 + 0] = quantizeUnorm8(color.r);
+    frameBuffer[index * 3 + 1] = quantizeUnorm8(color.g);
+    frameBuffer[index * 3 + 2] = quantizeUnorm8(color.b);
+}
+
+void updateHiZBlock(int block_x, int block_y) {
+    int x0 = block_x * coarseBlockSize;
+    int y0 = block_y * coarseBlockSize;
+    int x1 = std::min(x0 + coarseBlockSize, screenWidth);
+    int y1 = std::min(y0 + coarseBlockSize, screenHeight);
+
+    float z_max = 0.0f;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            z_max = std::max(z_max, storedDepthDistance(y * screenWidth + x));
+        }
+    }
+    hiZBuffer[block_y * hiZWidth + block_x] = z_max;
+}
+
+float farthestHiZ(int x0, int y0, int x1, int y1) {
+    float farthest_z = 0.0f;
+    for (int hy = y0 / coarseBlockSize; hy <= y1 / coarseBlockSize; ++hy) {
+        for (int hx = x0 / coarseBlockSize; hx <= x1 / coarseBlockSize; ++hx) {
+            farthest_z = std::max(farthest_z, hiZBuffer[hy * hiZWidth + hx]);
+        }
+    }
+    return farthest_z;
+}
+
+void planeRange(const AttributePlane& plane, int x0, int y0, int x1, int y1, float& lo, float& hi) {
+    float at_corner = plane.at(static_cast<float>(x0) + 0.5f, static_cast<float>(y0) + 0.5f);
+    lo = at_corner + std::min(plane.dx * (x1 - x0), 0.0f) + std::min(plane.dy * (y1 - y0), 0.0f);
+    hi = at_corner + std::max(plane.dx * (x1 - x0), 0.0f) + std::max(plane.dy * (y1 - y0), 0.0f);
+}
+
+float nearestPlaneDepth(const AttributePlane& z_ndc, int x0, int y0, int x1, int y1) {
+    float z_lo, z_hi;
+    planeRange(z_ndc, x0, y0, x1, y1, z_lo, z_hi);
+    return depthDistance(reversedZ ? z_hi : z_lo);
+}
+
+float farthestPlaneDepth(const AttributePlane& z_ndc, int x0, int y0, int x1, int y1) {
+    float z_lo, z_hi;
+    planeRange(z_ndc, x0, y0, x1, y1, z_lo, z_hi);
+    return depthDistance(reversedZ ? z_lo : z_hi);
+}
+
+std::vector<DepthBlock> depthBlocks(hiZWidth * hiZHeight);
+
+void resetDepthBlocks() {
+    DepthBlock cleared = { DepthBlockState::Clear, { 0.0f, 0.0f, 0.0f }, clearedDepthDistance };
+    std::fill(depthBlocks.begin(), depthBlocks.end(), cleared);
+}
+
+void expandDepthBlock(int block_x, int block_y) {
+    DepthBlock& block = depthBlocks[block_y * hiZWidth + block_x];
+    if (block.state == DepthBlockState::Pixels) {
+        return;
+    }
+
+    int x0 = block_x * coarseBlockSize;
+    int y0 = block_y * coarseBlockSize;
+    int x1 = std::min(x0 + coarseBlockSize, screenWidth);
+    int y1 = std::min(y0 + coarseBlockSize, screenHeight);
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            if (block.state == DepthBlockState::Clear) {
+                clearDepthPixel(y * screenWidth + x);
+            }
+            else {
+                storeDepth(y * screenWidth + x, block.z_ndc.at(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f));
+            }
+        }
+    }
+    block.state = DepthBlockState::Pixels;
+}
+
+void expandDepthBlocks(int x0, int y0, int x1, int y1) {
+    if (!useCompressedDepth || x0 > x1 || y0 > y1) {
+        return;
+    }
+    for (int hy = y0 / coarseBlockSize; hy <= y1 / coarseBlockSize; ++hy) {
+        for (int hx = x0 / coarseBlockSize; hx <= x1 / coarseBlockSize; ++hx) {
+            expandDepthBlock(hx, hy);
+        }
+    }
+}
+
+bool replacesDepthBlock(const DepthBlock& block, const DepthPlanes& planes, int x0, int y0) {
+    if (block.state == DepthBlockState::Pixels) {
+        return false;
+    }
+
+    int x1 = x0 + coarseBlockSize - 1;
+    int y1 = y0 + coarseBlockSize - 1;
+    float inv_w_lo, inv_w_hi, z_lo, z_hi;
+    planeRange(planes.inv_w, x0, y0, x1, y1, inv_w_lo, inv_w_hi);
+    planeRange(planes.z_ndc, x0, y0, x1, y1, z_lo, z_hi);
+    if (inv_w_lo < 2.0f * std::numeric_limits<float>::epsilon() || z_lo < depthNdcMin || z_hi > 1.0f) {
+        return false;
+    }
+    return depthDistance(reversedZ ? z_lo : z_hi) + hiZTolerance + depthCodeStep < block.nearest;
+}
+
+bool isDepthWritten(int index) {
+    if (isTileCleared(index)) {
+        return false;
+    }
+    if (useCompressedDepth) {
+        const DepthBlock& block = depthBlocks[(index / screenWidth / coarseBlockSize) * hiZWidth + (index % screenWidth) / coarseBlockSize];
+        if (block.state != DepthBlockState::Pixels) {
+            return block.state == DepthBlockState::Plane;
+        }
+    }
+    switch (depthFormat) {
+    case DepthFormat::Unorm16:
+        return depthBuffer16[index] != depthUnorm16Max;
+    case DepthFormat::Unorm24:
+        return depthBuffer24[index] != depthUnorm24Max;
+    default:
+        return std::abs(depthBuffer[index]) != std::numeric_limits<float>::max();
+    }
+}
+
+bool isMeshletOccluded(const Meshlet& meshlet, const glm::mat4& mvpMatrix) {
+    float min_x = std::numeric_limits<float>::max();
+    float min_y = std::numeric_limits<float>::max();
+    float max_x = -std::numeric_limits<float>::max();
+    float max_y = -std::numeric_limits<float>::max();
+    float nearest_z = std::numeric_limits<float>::max();
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec3 offset(
+            (corner & 1) ? meshlet.radius : -meshlet.radius,
+            (corner & 2) ? meshlet.radius : -meshlet.radius,
+            (corner & 4) ? meshlet.radius : -meshlet.radius);
+        glm::vec4 corner_clip = mvpMatrix * glm::vec4(meshlet.center + offset, 1.0f);
+        if (glm::dot(clipPlanes[0], corner_clip) < 0.0f) {
+            return false; // reaches past the near plane
+        }
+
+        glm::vec2 corner_screen = clipToScreen(corner_clip);
+        min_x = std::min(min_x, corner_screen.x);
+        min_y = std::min(min_y, corner_screen.y);
+        max_x = std::max(max_x, corner_screen.x);
+        max_y = std::max(max_y, corner_screen.y);
+        nearest_z = std::min(nearest_z, depthDistance(corner_clip.z / corner_clip.w));
+    }
+
+    int x0 = static_cast<int>(std::max(0.0f, min_x));
+    int y0 = static_cast<int>(std::max(0.0f, min_y));
+    int x1 = static_cast<int>(std::min(static_cast<float>(screenWidth - 1), std::ceil(max_x)));
+    int y1 = static_cast<int>(std::min(static_cast<float>(screenHeight - 1), std::ceil(max_y)));
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+    return nearest_z - hiZTolerance >= farthestHiZ(x0, y0, x1, y1);
+}
+
+bool fitsInt32Lanes(const FixedEdgeEquation& f, int x0, int y0, int x1, int y1) {
+    const int64_t limit = std::numeric_limits<int32_t>::max();
+    int64_t px0 = (static_cast<int64_t>(x0) << subpixelBits) + subpixelScale / 2;
+    int64_t py0 = (static_cast<int64_t>(y0) << subpixelBits) + subpixelScale / 2;
+    int64_t w = f.evaluate(px0, py0);
+    int64_t dx = f.stepX * (x1 - x0);
+    int64_t dy = f.stepY * (y1 - y0);
+    int64_t w_min = w + std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0);
+    int64_t w_max = w + std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0);
+    return w_min > -limit && w_max < limit;
+}
+
+bool coversAnyPixelCenter(const FixedEdgeEquation& f0, const FixedEdgeEquation& f1, const FixedEdgeEquation& f2,
+    int x0, int y0, int x1, int y1) {
+#ifdef RASTER_HAS_SSE2
+    const int xa = x0 & ~3;
+    const __m128i lane_x = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i x_lo = _mm_set1_epi32(x0 - 1);
+    const __m128i x_hi = _mm_set1_epi32(x1 + 1);
+    const __m128i minus_one = _mm_set1_epi32(-1);
+    const int32_t s0 = static_cast<int32_t>(f0.stepX);
+    const int32_t s1 = static_cast<int32_t>(f1.stepX);
+    const int32_t s2 = static_cast<int32_t>(f2.stepX);
+    const __m128i lane_w0 = _mm_setr_epi32(0, s0, 2 * s0, 3 * s0);
+    const __m128i lane_w1 = _mm_setr_epi32(0, s1, 2 * s1, 3 * s1);
+    const __m128i lane_w2 = _mm_setr_epi32(0, s2, 2 * s2, 3 * s2);
+
+    __m128i covered = _mm_setzero_si128();
+    for (int x = xa; x <= x1; x += 4) {
+        int64_t px = (static_cast<int64_t>(x) << subpixelBits) + subpixelScale / 2;
+        __m128i xs = _mm_add_epi32(_mm_set1_epi32(x), lane_x);
+        __m128i in_range = _mm_and_si128(_mm_cmpgt_epi32(xs, x_lo), _mm_cmplt_epi32(xs, x_hi));
+        for (int y = y0; y <= y1; ++y) {
+            int64_t py = (static_cast<int64_t>(y) << subpixelBits) + subpixelScale / 2;
+            __m128i w0 = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(f0.evaluate(px, py) + f0.bias)), lane_w0);
+            __m128i w1 = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(f1.evaluate(px, py) + f1.bias)), lane_w1);
+            __m128i w2 = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(f2.evaluate(px, py) + f2.bias)), lane_w2);
+            __m128i mask = _mm_and_si128(in_range, _mm_cmpgt_epi32(w0, minus_one));
+            mask = _mm_and_si128(mask, _mm_cmpgt_epi32(w1, minus_one));
+            mask = _mm_and_si128(mask, _mm_cmpgt_epi32(w2, minus_one));
+            covered = _mm_or_si128(covered, mask);
+        }
+    }
+    return _mm_movemask_epi8(covered) != 0;
+#else
+    for (int y = y0; y <= y1; ++y) {
+        int64_t py = (static_cast<int64_t>(y) << subpixelBits) + subpixelScale / 2;
+        for (int x = x0; x <= x1; ++x) {
+            int64_t px = (static_cast<int64_t>(x) << subpixelBits) + subpixelScale / 2;
+            if (f0.evaluate(px, py) + f0.bias >= 0 && f1.evaluate(px, py) + f1.bias >= 0 && f2.evaluate(px, py) + f2.bias >= 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+#endif
+}
+
+#ifdef RASTER_HAS_SSE2
+int depthTestAndWriteSse2(int index, __m128 z_ndc, __m128 pass) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    if (depthFormat == DepthFormat::Unorm16 || depthFormat == DepthFormat::Unorm24) {
+        const __m128 max_code = _mm_set1_ps(static_cast<float>(
+            depthFormat == DepthFormat::Unorm16 ? depthUnorm16Max : depthUnorm24Max));
+        __m128 z_window = _mm_mul_ps(_mm_add_ps(z_ndc, one), half);
+        __m128 code_f = _mm_add_ps(_mm_mul_ps(_mm_max_ps(z_window, _mm_setzero_ps()), max_code), half);
+        __m128i code = _mm_cvttps_epi32(_mm_min_ps(code_f, max_code));
+
+        __m128i z_old;
+        if (depthFormat == DepthFormat::Unorm16) {
+            z_old = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&depthBuffer16[index])), _mm_setzero_si128());
+        }
+        else {
+            z_old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&depthBuffer24[index]));
+        }
+        __m128i pass_i = _mm_and_si128(_mm_castps_si128(pass), _mm_cmplt_epi32(code, z_old));
+        int pass_bits = _mm_movemask_ps(_mm_castsi128_ps(pass_i));
+        if (pass_bits == 0) {
+            return 0;
+        }
+
+        __m128i z_new = _mm_or_si128(_mm_and_si128(pass_i, code), _mm_andnot_si128(pass_i, z_old));
+        if (depthFormat == DepthFormat::Unorm16) {
+            // SSE2 only packs with signed saturation, so the codes are biased into int16 and back
+            const __m128i bias = _mm_set1_epi32(0x8000);
+            __m128i biased = _mm_sub_epi32(z_new, bias);
+            __m128i packed = _mm_xor_si128(_mm_packs_epi32(biased, biased), _mm_set1_epi16(static_cast<short>(0x8000)));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(&depthBuffer16[index]), packed);
+        }
+        else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&depthBuffer24[index]), z_new);
+        }
+        return pass_bits;
+    }
+
+    float* depth_row = &depthBuffer[index];
+    __m128 z_new = reversedZ ? z_ndc : _mm_mul_ps(_mm_add_ps(z_ndc, one), half);
+    __m128 z_old = _mm_loadu_ps(depth_row);
+    pass = _mm_and_ps(pass, reversedZ ? _mm_cmpgt_ps(z_new, z_old) : _mm_cmplt_ps(z_new, z_old));
+
+    int pass_bits = _mm_movemask_ps(pass);
+    if (pass_bits != 0) {
+        _mm_storeu_ps(depth_row, _mm_or_ps(_mm_and_ps(pass, z_new), _mm_andnot_ps(pass, z_old)));
+    }
+    return pass_bits;
+}
+#endif
+
+VertexStreams makeVertexStreams() {
+    VertexStreams streams;
+    streams.x.resize(gNumVertices);
+    streams.y.resize(gNumVertices);
+    streams.z.resize(gNumVertices);
+    for (int k = 0; k < gNumVertices; ++k) {
+        streams.x[k] = gVertexBuffer[k].x;
+        streams.y[k] = gVertexBuffer[k].y;
+        streams.z[k] = gVertexBuffer[k].z;
+    }
+    return streams;
+}
+
+#ifdef RASTER_HAS_SSE2
+// A matrix with every element broadcast to all four lanes, for transforming four points at once
+struct Sse2Matrix {
+    __m128 m[4][4]; // m[column][row], as glm::mat4
+
+    explicit Sse2Matrix(const glm::mat4& matrix) {
+        for (int c = 0; c < 4; ++c) {
+            for (int r = 0; r < 4; ++r) {
+                m[c][r] = _mm_set1_ps(matrix[c][r]);
+            }
+        }
+    }
+
+    // Row r of matrix * (x, y, z, 1), summed in the same order as glm's mat4 * vec4:
+    // (m0 * x + m1 * y) + (m2 * z + m3 * w), with m3 * 1 exact
+    __m128 transformPoint(int r, __m128 x, __m128 y, __m128 z) const {
+        return _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(m[0][r], x), _mm_mul_ps(m[1][r], y)),
+            _mm_add_ps(_mm_mul_ps(m[2][r], z), m[3][r]));
+    }
+};
+
+// Transforms vertices [first, first + 4) of the streams. The normal is normalize(world - center)
+// evaluated as glm::normalize does, so results match the scalar path bit for bit.
+void transformVerticesSse2(const VertexStreams& streams, int first,
+    const Sse2Matrix& mvp, const Sse2Matrix& model, TransformedVertex* out) {
+    __m128 x = _mm_loadu_ps(&streams.x[first]);
+    __m128 y = _mm_loadu_ps(&streams.y[first]);
+    __m128 z = _mm_loadu_ps(&streams.z[first]);
+
+    alignas(16) float clip[4][4];
+    alignas(16) float world[3][4];
+    alignas(16) float normal[3][4];
+    for (int r = 0; r < 4; ++r) {
+        _mm_store_ps(clip[r], mvp.transformPoint(r, x, y, z));
+    }
+
+    __m128 world_lanes[3];
+    __m128 offset[3];
+    for (int r = 0; r < 3; ++r) {
+        world_lanes[r] = model.transformPoint(r, x, y, z);
+        offset[r] = _mm_sub_ps(world_lanes[r], _mm_set1_ps(g_sphere_center_world[r]));
+        _mm_store_ps(world[r], world_lanes[r]);
+    }
+
+    __m128 length_sq = _mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(offset[0], offset[0]), _mm_mul_ps(offset[1], offset[1])), _mm_mul_ps(offset[2], offset[2]));
+    __m128 inv_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_sq));
+    for (int r = 0; r < 3; ++r) {
+        _mm_store_ps(normal[r], _mm_mul_ps(offset[r], inv_length));
+    }
+
+    for (int k = 0; k < 4; ++k) {
+        out[k].v_clip = glm::vec4(clip[0][k], clip[1][k], clip[2][k], clip[3][k]);
+        out[k].v_world = glm::vec3(world[0][k], world[1][k], world[2][k]);
+        out[k].n_world_norm = glm::vec3(normal[0][k], normal[1][k], normal[2][k]);
+    }
+}
+#endif
+
+std::vector<TransformedVertex> transformVertices(const VertexStreams& streams, const glm::mat4& mvpMatrix) {
+    int count = static_cast<int>(streams.x.size());
+    std::vector<TransformedVertex> vertices(count);
+
+    int k = 0;
+#ifdef RASTER_HAS_SSE2
+    if (useSimdVertexKernel) {
+        Sse2Matrix mvp(mvpMatrix);
+        Sse2Matrix model(g_modelMatrix);
+        for (; k + 4 <= count; k += 4) {
+            transformVerticesSse2(streams, k, mvp, model, &vertices[k]);
+        }
+    }
+#endif
+    for (; k < count; ++k) {
+        glm::vec4 v_model = glm::vec4(streams.x[k], streams.y[k], streams.z[k], 1.0f);
+
+        vertices[k].v_clip = mvpMatrix * v_model;
+        vertices[k].v_world = glm::vec3(g_modelMatrix * v_model);
+        vertices[k].n_world_norm = glm::normalize(vertices[k].v_world - g_sphere_center_world);
+    }
+    return vertices;
+}
+
+void presentFrameBuffer() {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (!useLazyClear) {
+        glDrawPixels(screenWidth, screenHeight, GL_RGB, GL_UNSIGNED_BYTE, frameBuffer.data());
+        return;
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, screenWidth);
+    for (int tile = 0; tile < tileCountX * tileCountY; ++tile) {
+        if (tileCleared[tile]) {
+            continue;
+        }
+        ScreenRect rect = tileRect(tile);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.minX);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.minY);
+        glWindowPos2i(rect.minX, rect.minY);
+        glDrawPixels(rect.maxX - rect.minX + 1, rect.maxY - rect.minY + 1, GL_RGB, GL_UNSIGNED_BYTE, frameBuffer.data());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glWindowPos2i(0, 0);
+}
+
+void printFrameStats() {
+    std::cout << "Culled triangles: " << g_cullStats.projection << " projection, "
+        << g_cullStats.degenerate << " degenerate, " << g_cullStats.face << " face, "
+        << g_cullStats.clipped << " clipped" << std::endl;
+    std::cout << "Culled meshlets: " << g_cullStats.meshlet_frustum << " frustum, "
+        << g_cullStats.meshlet_cone << " cone" << ", "
+        << g_cullStats.meshlet_occluded << " occluded" << " of " << gNumMeshlets << std::endl;
+
+    int64_t covered_pixels = 0;
+    for (int i = 0; i < screenWidth * screenHeight; ++i) {
+        covered_pixels += isDepthWritten(i) ? 1 : 0;
+    }
+    int64_t depth_passed = g_shadingStats.depth_passed;
+    int64_t shaded = g_shadingStats.shaded;
+    std::cout << "Fragments: " << depth_passed << " passed the depth test, " << shaded << " shaded, "
+        << covered_pixels << " pixels covered" << std::endl;
+    if (covered_pixels > 0) {
+        std::cout << "Overdraw: " << static_cast<double>(depth_passed) / covered_pixels << "x, shading work saved: "
+            << depth_passed - shaded << " fragments" << std::endl;
+    }
+    if (useCompressedDepth) {
+        int block_counts[3] = { 0, 0, 0 };
+        for (const DepthBlock& block : depthBlocks) {
+            ++block_counts[static_cast<int>(block.state)];
+        }
+        std::cout << "Depth blocks: " << block_counts[0] << " clear, " << block_counts[1] << " plane, "
+            << block_counts[2] << " per-pixel of " << depthBlocks.size() << std::endl;
+    }
+}
@@ -0,0 +1,1089 @@
+#pragma once
+#ifndef RENDER_PIPELINE_H
+#define RENDER_PIPELINE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "rasterizer.h"
+
+// Rendering pipeline shared by the Q1, Q2 and Q3 viewers, templated on a shader policy: vertex
+// transform, fixed-point rasterization with hierarchical and SIMD traversal, hierarchical and
+// compressed depth, a visibility buffer and a tiled multi-threaded backend.
+
+// Model matrix of the mesh being drawn and its sphere's center in world space, read by the
+// vertex stage
+extern glm::mat4 g_modelMatrix;
+extern glm::vec3 g_sphere_center_world;
+
+// Rasterizer coverage evaluation mode
+enum class RasterMode {
+    Reference,   // edgeFunction evaluated from scratch at every pixel
+    Incremental, // edge equations set up once per triangle, stepped with adds
+    FixedPoint   // vertices snapped to a subpixel grid, integer edges with top-left fill rule
+};
+const RasterMode rasterMode = RasterMode::FixedPoint;
+
+// 28.4 fixed-point screen coordinates: 16 x 16 subpixel positions per pixel
+const int subpixelBits = 4;
+const int subpixelScale = 1 << subpixelBits;
+// Snapped coordinates are kept within +-2^23 so edge products fit comfortably in int64
+const float subpixelRangeLimit = static_cast<float>(1 << (23 - subpixelBits));
+// For vertices and pixel centers within +-maxSnappedCoordinate (m), a FixedEdgeEquation has
+// |A|, |B| <= 2m and |C| <= 4m^2, so its value is at most 8m^2 = 2^49 in magnitude
+const int64_t maxSnappedCoordinate = static_cast<int64_t>(1 << (23 - subpixelBits)) * subpixelScale;
+static_assert(8 * maxSnappedCoordinate * maxSnappedCoordinate <= (static_cast<int64_t>(1) << 49),
+    "edge values at the largest snapped extent must fit in int64 with room for the steps");
+
+// Hierarchical traversal for the fixed-point path: coarseBlockSize x coarseBlockSize blocks are
+// classified against the three edges before any per-pixel coverage test (power of two).
+const bool useHierarchicalTraversal = true;
+const int coarseBlockSize = 8;
+
+// SSE2 pixel kernel for the fixed-point path: coverage, barycentrics and depth for 4 pixels
+// at a time, with a masked depth test/write. Used when the target has SSE2 and the triangle's
+// edge values fit in int32; otherwise the scalar walk runs.
+const bool useSimdRasterKernel = true;
+static_assert(screenWidth % 4 == 0, "SIMD kernel loads 4-pixel groups that must not cross a row");
+
+// Small-triangle path for the fixed-point rasterizer: a triangle whose pixel bounding box is at
+// most smallTriangleStamp pixels on a side has its coverage tested as one stamp before any
+// attribute setup, is dropped when it covers no pixel center, and otherwise skips the
+// hierarchical-Z and coarse-block stages. Most triangles of a finely tessellated sphere qualify.
+const bool useSmallTrianglePath = true;
+const int smallTriangleStamp = 4;
+
+// SSE2 vertex kernel: clip position, world position and normal for 4 vertices at a time from
+// structure-of-arrays positions. Leftover vertices go through the scalar path.
+const bool useSimdVertexKernel = true;
+
+// Tiled backend: triangles are binned into tileSize x tileSize screen tiles and each tile is
+// rasterized by one worker thread, so no two threads ever touch the same framebuffer pixel.
+// Every bin lists its triangles in submission order, so depth ties go to the lower primitive ID
+// exactly as in the single-threaded path, and the image is bit-identical for any thread count.
+const bool useTiledRenderer = true;
+const int tileSize = 64;
+const int tileCountX = (screenWidth + tileSize - 1) / tileSize;
+const int tileCountY = (screenHeight + tileSize - 1) / tileSize;
+const unsigned int renderThreadCount = 0; // 0 = std::thread::hardware_concurrency()
+static_assert(tileSize % 4 == 0, "SIMD kernel writes 4-pixel groups that must stay inside one tile");
+
+// Hierarchical Z: the farthest depth stored in each coarseBlockSize x coarseBlockSize block of
+// the depth buffer, as a storedDepthDistance. The fixed-point path skips whole triangles and
+// blocks whose nearest depth is behind it. Stored distances only decrease during a frame, so an
+// entry that has not been refreshed yet is still a valid (looser) bound.
+const bool useHierarchicalZ = true;
+const int hiZWidth = (screenWidth + coarseBlockSize - 1) / coarseBlockSize;
+const int hiZHeight = (screenHeight + coarseBlockSize - 1) / coarseBlockSize;
+// Slack for the difference between the corner evaluation and the per-pixel depth arithmetic
+const float hiZTolerance = 1e-6f;
+static_assert(tileSize % coarseBlockSize == 0, "a hierarchical-Z block must belong to exactly one tile");
+extern std::vector<float> hiZBuffer;
+
+// Compressed depth: each hierarchical-Z block is cleared, holds the depth plane of a single
+// triangle, or stores depth per pixel. A triangle that covers a whole block and lies in front of
+// everything it holds replaces it by its plane without reading or writing per-pixel depth;
+// blocks only fall back to per-pixel depth where triangles meet or overlap partially.
+const bool useCompressedDepth = true;
+
+// Visibility buffer: the raster pass only records, per pixel, the index of the triangle that won
+// the depth test, and a resolve pass shades every covered pixel exactly once from that
+// triangle's attribute planes. Fragments that are later overdrawn are never shaded.
+const bool useVisibilityBuffer = true;
+const int emptyVisibilityId = -1;
+extern std::vector<int> visibilityBuffer;
+
+// Fragment counts for the overdraw report, summed over all tile workers
+struct ShadingStats {
+    std::atomic<int64_t> depth_passed{ 0 }; // fragments that passed the depth test
+    std::atomic<int64_t> shaded{ 0 };       // fragment-stage invocations
+};
+extern ShadingStats g_shadingStats;
+
+// Inclusive pixel rectangle
+struct ScreenRect {
+    int minX, minY, maxX, maxY;
+};
+const ScreenRect fullScreenRect = { 0, 0, screenWidth - 1, screenHeight - 1 };
+
+// Lazy clear: clearing the frame only marks every tile cleared. The first triangle that reaches a
+// tile writes the clear values into its color, visibility and (uncompressed) depth pixels; tiles
+// that no triangle reaches are never written, and presentFrameBuffer does not upload them.
+const bool useLazyClear = true;
+extern std::vector<uint8_t> tileCleared; // one byte per tile, written by its owning worker only
+
+ScreenRect tileRect(int tile);
+
+// Clears color, visibility, depth and the hierarchical Z buffer. Compressed depth is cleared by
+// resetting its blocks, and with lazy clears no pixel is written here.
+void clearFrame();
+
+// Writes the deferred clear of every still-cleared tile that overlaps [x0, x1] x [y0, y1]; called
+// before a triangle writes any pixel there
+void clearTilesOnFirstWrite(int x0, int y0, int x1, int y1);
+
+// True while the pixel's tile still holds its deferred clear
+bool isTileCleared(int index);
+
+int tileAt(int x, int y);
+
+float edgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c);
+
+// Rejects triangles that cannot be projected to the screen
+bool passesProjectionTest(const glm::vec4& v0_clip, const glm::vec4& v1_clip, const glm::vec4& v2_clip, CullStats* stats);
+
+glm::vec2 clipToScreen(const glm::vec4& v_clip);
+
+// edgeFunction(a, b, p) written as a linear function of p: A * p.x + B * p.y + C.
+// Moving one pixel right adds A, moving one pixel down adds B.
+struct EdgeEquation {
+    float A, B, C;
+
+    EdgeEquation(const glm::vec2& a, const glm::vec2& b)
+        : A(b.y - a.y), B(a.x - b.x), C(a.y * (b.x - a.x) - a.x * (b.y - a.y)) {}
+
+    float evaluate(const glm::vec2& p) const {
+        return A * p.x + B * p.y + C;
+    }
+};
+
+bool isSubpixelRepresentable(const glm::vec2& v0, const glm::vec2& v1, const glm::vec2& v2);
+
+glm::ivec2 snapToSubpixel(const glm::vec2& v);
+
+// Integer form of EdgeEquation on the subpixel grid.
+// For a positive-area triangle with y pointing down, an edge is "left" when the
+// interior lies towards +x (A > 0) and "top" when it is horizontal with the interior below (B > 0).
+// Pixel centers exactly on any other edge belong to the neighbouring triangle.
+struct FixedEdgeEquation {
+    int64_t A, B, C;
+    int64_t stepX, stepY; // change per whole pixel
+    int64_t bias;         // 0 for top-left edges, -1 otherwise
+
+    FixedEdgeEquation(const glm::ivec2& a, const glm::ivec2& b)
+        : A(static_cast<int64_t>(b.y) - a.y),
+          B(static_cast<int64_t>(a.x) - b.x),
+          C(static_cast<int64_t>(a.y) * (b.x - a.x) - static_cast<int64_t>(a.x) * (b.y - a.y)) {
+        stepX = A * subpixelScale;
+        stepY = B * subpixelScale;
+        bool is_top_left = (A > 0) || (A == 0 && B > 0);
+        bias = is_top_left ? 0 : -1;
+    }
+
+    int64_t evaluate(int64_t px, int64_t py) const {
+        return A * px + B * py + C;
+    }
+};
+
+// Screen-space plane value(x, y) = dx * x + dy * y + c of a quantity that varies linearly across
+// a triangle in screen space, with (x, y) in pixels.
+struct AttributePlane {
+    float dx, dy, c;
+
+    float at(float x, float y) const {
+        return dx * x + dy * y + c;
+    }
+};
+
+AttributePlane setupPlane(const glm::vec2& v0, const glm::vec2& v1, const glm::vec2& v2, float a0, float a1, float a2);
+
+// Triangle setup: 1/w, NDC depth and every varying divided by w as screen-space planes, so a
+// pixel costs one plane evaluation per quantity plus a single reciprocal to undo the 1/w.
+// Coverage and depth only need the DepthPlanes part.
+struct DepthPlanes {
+    AttributePlane inv_w; // 1 / w_clip
+    AttributePlane z_ndc; // z_clip / w_clip, linear in screen space as is
+};
+
+template <int VaryingCount>
+struct TrianglePlanes : DepthPlanes {
+    AttributePlane varyings_over_w[VaryingCount]; // varying / w_clip
+};
+
+template <int VaryingCount>
+TrianglePlanes<VaryingCount> setupTrianglePlanes(
+    const glm::vec2& v0_screen, const glm::vec2& v1_screen, const glm::vec2& v2_screen,
+    const glm::vec4& v0_clip, const glm::vec4& v1_clip, const glm::vec4& v2_clip,
+    const float* v0_varyings, const float* v1_varyings, const float* v2_varyings) {
+
+    float inv_w0 = 1.0f / v0_clip.w;
+    float inv_w1 = 1.0f / v1_clip.w;
+    float inv_w2 = 1.0f / v2_clip.w;
+
+    TrianglePlanes<VaryingCount> planes;
+    planes.inv_w = setupPlane(v0_screen, v1_screen, v2_screen, inv_w0, inv_w1, inv_w2);
+    planes.z_ndc = setupPlane(v0_screen, v1_screen, v2_screen, v0_clip.z * inv_w0, v1_clip.z * inv_w1, v2_clip.z * inv_w2);
+    for (int k = 0; k < VaryingCount; ++k) {
+        planes.varyings_over_w[k] = setupPlane(v0_screen, v1_screen, v2_screen,
+            v0_varyings[k] * inv_w0, v1_varyings[k] * inv_w1, v2_varyings[k] * inv_w2);
+    }
+    return planes;
+}
+
+// Attribute planes of a stored triangle, set up exactly as rasterizeTriangle does: on the snapped
+// positions when the fixed-point path rasterizes it, and in the flipped vertex order for a
+// negative-area triangle. The planes are equal in exact arithmetic either way, but the resolve
+// pass must reproduce immediate-mode colors bit for bit.
+template <int VaryingCount>
+TrianglePlanes<VaryingCount> setupTrianglePlanes(const ClipTriangle<VaryingCount>& tri) {
+    glm::vec2 v_screen[3] = { clipToScreen(tri.v_clip[0]), clipToScreen(tri.v_clip[1]), clipToScreen(tri.v_clip[2]) };
+    int order[3] = { 0, 1, 2 };
+    if (edgeFunction(v_screen[0], v_screen[1], v_screen[2]) < 0.0f) {
+        std::swap(order[1], order[2]);
+    }
+    if (rasterMode == RasterMode::FixedPoint && isSubpixelRepresentable(v_screen[0], v_screen[1], v_screen[2])) {
+        for (glm::vec2& v : v_screen) {
+            v = glm::vec2(snapToSubpixel(v)) / static_cast<float>(subpixelScale);
+        }
+    }
+    const int i0 = order[0], i1 = order[1], i2 = order[2];
+    return setupTrianglePlanes<VaryingCount>(v_screen[i0], v_screen[i1], v_screen[i2],
+        tri.v_clip[i0], tri.v_clip[i1], tri.v_clip[i2],
+        tri.varyings[i0], tri.varyings[i1], tri.varyings[i2]);
+}
+
+// Perspective-correct varyings at the center of pixel (x, y). The caller has checked that 1/w
+// does not vanish there.
+template <int VaryingCount>
+void interpolateVaryings(const TrianglePlanes<VaryingCount>& planes, int x, int y, float* varyings) {
+    float px = static_cast<float>(x) + 0.5f;
+    float py = static_cast<float>(y) + 0.5f;
+    float w_clip = 1.0f / planes.inv_w.at(px, py);
+
+    for (int k = 0; k < VaryingCount; ++k) {
+        varyings[k] = planes.varyings_over_w[k].at(px, py) * w_clip;
+    }
+}
+
+// Quantizes and stores a gamma-encoded color
+void writePixelColor(int x, int y, const glm::vec3& color);
+
+// Batched shading: pixels are collected in structure-of-arrays form and handed to the shader's
+// fragment stage shadeBatchSize at a time, so a shader can work on 4 pixels per SSE2 vector.
+const int shadeBatchSize = 8;
+static_assert(shadeBatchSize % 4 == 0, "SIMD fragment stages work on whole 4-pixel groups");
+
+// Pixels waiting to be shaded, all in one tile: interpolated varyings in, gamma-encoded colors
+// out. Lanes past count up to the next multiple of 4 repeat the last pixel when the fragment
+// stage runs.
+template <int VaryingCount>
+struct PixelBatch {
+    int count;
+    int tile; // tileAt of every pixel, for per-tile shader state such as a light list
+    int x[shadeBatchSize];
+    int y[shadeBatchSize];
+    float varyings[VaryingCount][shadeBatchSize];
+    float color_r[shadeBatchSize], color_g[shadeBatchSize], color_b[shadeBatchSize];
+};
+
+// Runs the shader's fragment stage on the batch, writes its pixels to the frame buffer and
+// empties it
+template <typename Shader>
+void flushPixelBatch(PixelBatch<Shader::varyingCount>& batch) {
+    if (batch.count == 0) {
+        return;
+    }
+    for (int pad = batch.count; pad % 4 != 0; ++pad) {
+        for (int k = 0; k < Shader::varyingCount; ++k) {
+            batch.varyings[k][pad] = batch.varyings[k][batch.count - 1];
+        }
+    }
+    Shader::shade(batch);
+
+    for (int i = 0; i < batch.count; ++i) {
+        writePixelColor(batch.x[i], batch.y[i], glm::vec3(batch.color_r[i], batch.color_g[i], batch.color_b[i]));
+    }
+    batch.count = 0;
+}
+
+// Queues pixel (x, y) for shading, flushing the batch first when it is full or holds another
+// tile's pixels
+template <typename Shader>
+void addPixelToBatch(PixelBatch<Shader::varyingCount>& batch, int x, int y, const float* varyings) {
+    int tile = tileAt(x, y);
+    if (batch.count == shadeBatchSize || (batch.count > 0 && tile != batch.tile)) {
+        flushPixelBatch<Shader>(batch);
+    }
+    batch.tile = tile;
+    int i = batch.count++;
+    batch.x[i] = x;
+    batch.y[i] = y;
+    for (int k = 0; k < Shader::varyingCount; ++k) {
+        batch.varyings[k][i] = varyings[k];
+    }
+}
+
+// Shader policies. The rasterizer, the visibility-buffer resolve and the tile workers are
+// templates on the policy, so each material compiles to its own loops with every stage inlined
+// and no per-pixel indirection. A policy provides
+//   varyingCount                       floats per vertex, interpolated perspective-correctly
+//   name()                             shading model, for the log
+//   vertex(world, normal, varyings)    vertex stage, once per transformed vertex
+//   primitive(v0, v1, v2)              once per triangle before clipping, on its corners' varyings
+//   beginTile(tile, nearest_w, farthest_w)
+//                                      before a tile's pixels are shaded, with the range of view
+//                                      depth w_clip they can have
+//   shade(batch)                       fragment stage: gamma-encoded colors for a PixelBatch
+// Q1 (FlatShader), Q2 (GouraudShader) and Q3 (PhongShader) each define their policy as a
+// template on the Material it lights and draw with drawMesh.
+
+// Recomputes the hierarchical-Z entry of one block from the depth buffer
+void updateHiZBlock(int block_x, int block_y);
+
+// Farthest stored depth over the pixel rectangle [x0, x1] x [y0, y1]
+float farthestHiZ(int x0, int y0, int x1, int y1);
+
+// Smallest and largest value of a plane over the pixel centers of [x0, x1] x [y0, y1]. The
+// plane is affine, so its extremes are reached at corners.
+void planeRange(const AttributePlane& plane, int x0, int y0, int x1, int y1, float& lo, float& hi);
+
+// Nearest depth distance of the z_ndc plane over the pixel centers of [x0, x1] x [y0, y1]
+float nearestPlaneDepth(const AttributePlane& z_ndc, int x0, int y0, int x1, int y1);
+
+// Farthest depth distance of the z_ndc plane over the pixel centers of [x0, x1] x [y0, y1]
+float farthestPlaneDepth(const AttributePlane& z_ndc, int x0, int y0, int x1, int y1);
+
+// Compressed state of one hierarchical-Z block of the depth buffer
+enum class DepthBlockState : uint8_t {
+    Clear,  // every pixel holds the clear value
+    Plane,  // every pixel holds z_ndc of one triangle, as its fragments stored it
+    Pixels  // depth is stored per pixel
+};
+
+struct DepthBlock {
+    DepthBlockState state;
+    AttributePlane z_ndc; // Plane: the depth plane of the triangle that covers the block
+    float nearest;        // Clear and Plane: nearest depth distance in the block
+};
+extern std::vector<DepthBlock> depthBlocks;
+
+// Depth distance of a cleared pixel
+const float clearedDepthDistance = depthIsFloat ? std::numeric_limits<float>::max() : 1.0f;
+// Spacing of the fixed-point depth codes as a distance; a block-level test that has to agree with
+// the per-pixel one keeps this much more margin
+const float depthCodeStep =
+    depthFormat == DepthFormat::Unorm16 ? 1.0f / depthUnorm16Max :
+    depthFormat == DepthFormat::Unorm24 ? 1.0f / depthUnorm24Max : 0.0f;
+
+// Clears the depth buffer by marking every block Clear; no pixel is written
+void resetDepthBlocks();
+
+// Gives a block per-pixel depth before fragments are tested against it one by one. A Clear block
+// is filled with the clear value and a Plane block with its plane, evaluated exactly as the
+// fragments it stands for were.
+void expandDepthBlock(int block_x, int block_y);
+
+// Expands every block that overlaps the pixel rectangle [x0, x1] x [y0, y1]
+void expandDepthBlocks(int x0, int y0, int x1, int y1);
+
+// True when a triangle that covers every pixel center of the full block at (x0, y0) would pass
+// the per-pixel depth test at all of them: 1/w and z_ndc are valid across the block and its
+// farthest depth is in front of the block's nearest by more than the arithmetic can disagree.
+bool replacesDepthBlock(const DepthBlock& block, const DepthPlanes& planes, int x0, int y0);
+
+// True once a fragment has been written at index since the depth buffer was cleared
+bool isDepthWritten(int index);
+
+// True when the meshlet's bounding box is entirely behind the hierarchical Z buffer. Depth over
+// the box is extreme at a corner, so the 8 projected corners bound both its screen rectangle
+// and its nearest depth. Only meaningful while triangles are rasterized as they are submitted.
+bool isMeshletOccluded(const Meshlet& meshlet, const glm::mat4& mvpMatrix);
+
+// True when the edge values over [x0, x1] x [y0, y1] (pixel centers) fit in int32 lanes.
+bool fitsInt32Lanes(const FixedEdgeEquation& f, int x0, int y0, int x1, int y1);
+
+// True when any pixel center of [x0, x1] x [y0, y1], a rectangle of at most smallTriangleStamp
+// pixels on a side, is covered. Edge values near a triangle that small always fit in int32, so
+// the SSE2 stamp needs no range check; it tests each row as one or two aligned 4-pixel groups.
+bool coversAnyPixelCenter(const FixedEdgeEquation& f0, const FixedEdgeEquation& f1, const FixedEdgeEquation& f2,
+    int x0, int y0, int x1, int y1);
+
+#ifdef RASTER_HAS_SSE2
+// SSE2 depth test and masked write of the 4 pixels at index..index + 3, for the lanes set in
+// pass. Same arithmetic as depthTestAndWrite; returns the passing lanes as movemask bits.
+int depthTestAndWriteSse2(int index, __m128 z_ndc, __m128 pass);
+
+// SSE2 counterpart of the scalar fixed-point walk over [x0, x1] x [y0, y1].
+// Four horizontally adjacent pixels, aligned to a multiple of 4, are processed per step: the edge
+// values are int32 lanes, 1/w and depth come from the triangle's planes in float lanes (same
+// operation order as the scalar path), and the depth buffer is updated with a masked blend.
+// Lanes that pass the depth test are handed to shadeVisible(x, y) for shading.
+template <typename ShadeVisibleFn>
+void walkPixelsSse2(const FixedEdgeEquation& f0, const FixedEdgeEquation& f1, const FixedEdgeEquation& f2,
+    const DepthPlanes& planes, int x0, int y0, int x1, int y1, bool test_coverage, ShadeVisibleFn shadeVisible) {
+
+    const int xa = x0 & ~3;
+    const __m128i lane_x = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i x_lo = _mm_set1_epi32(x0 - 1);
+    const __m128i x_hi = _mm_set1_epi32(x1 + 1);
+    const __m128i minus_one = _mm_set1_epi32(-1);
+
+    const int32_t s0 = static_cast<int32_t>(f0.stepX);
+    const int32_t s1 = static_cast<int32_t>(f1.stepX);
+    const int32_t s2 = static_cast<int32_t>(f2.stepX);
+    const __m128i lane_w0 = _mm_setr_epi32(0, s0, 2 * s0, 3 * s0);
+    const __m128i lane_w1 = _mm_setr_epi32(0, s1, 2 * s1, 3 * s1);
+    const __m128i lane_w2 = _mm_setr_epi32(0, s2, 2 * s2, 3 * s2);
+    const __m128i step_w0 = _mm_set1_epi32(4 * s0);
+    const __m128i step_w1 = _mm_set1_epi32(4 * s1);
+    const __m128i step_w2 = _mm_set1_epi32(4 * s2);
+    const __m128i bias0 = _mm_set1_epi32(static_cast<int32_t>(f0.bias));
+    const __m128i bias1 = _mm_set1_epi32(static_cast<int32_t>(f1.bias));
+    const __m128i bias2 = _mm_set1_epi32(static_cast<int32_t>(f2.bias));
+
+    const __m128 inv_w_dx = _mm_set1_ps(planes.inv_w.dx);
+    const __m128 inv_w_dy = _mm_set1_ps(planes.inv_w.dy);
+    const __m128 inv_w_c = _mm_set1_ps(planes.inv_w.c);
+    const __m128 z_dx = _mm_set1_ps(planes.z_ndc.dx);
+    const __m128 z_dy = _mm_set1_ps(planes.z_ndc.dy);
+    const __m128 z_c = _mm_set1_ps(planes.z_ndc.c);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 inv_w_epsilon = _mm_set1_ps(std::numeric_limits<float>::epsilon());
+    const __m128 z_min = _mm_set1_ps(depthNdcMin - 1e-5f);
+    const __m128 z_max = _mm_set1_ps(1.0f + 1e-5f);
+    const __m128 lane_center = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+    int64_t px_start = (static_cast<int64_t>(xa) << subpixelBits) + subpixelScale / 2;
+    for (int y = y0; y <= y1; ++y) {
+        int64_t py = (static_cast<int64_t>(y) << subpixelBits) + subpixelScale / 2;
+        __m128i w0 = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(f0.evaluate(px_start, py))), lane_w0);
+        __m128i w1 = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(f1.evaluate(px_start, py))), lane_w1);
+        __m128i w2 = _mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(f2.evaluate(px_start, py))), lane_w2);
+        const __m128 center_y = _mm_set1_ps(static_cast<float>(y) + 0.5f);
+
+        for (int x = xa; x <= x1; x += 4, w0 = _mm_add_epi32(w0, step_w0), w1 = _mm_add_epi32(w1, step_w1), w2 = _mm_add_epi32(w2, step_w2)) {
+            __m128i xs = _mm_add_epi32(_mm_set1_epi32(x), lane_x);
+            __m128i mask = _mm_and_si128(_mm_cmpgt_epi32(xs, x_lo), _mm_cmplt_epi32(xs, x_hi));
+            if (test_coverage) {
+                mask = _mm_and_si128(mask, _mm_cmpgt_epi32(_mm_add_epi32(w0, bias0), minus_one));
+                mask = _mm_and_si128(mask, _mm_cmpgt_epi32(_mm_add_epi32(w1, bias1), minus_one));
+                mask = _mm_and_si128(mask, _mm_cmpgt_epi32(_mm_add_epi32(w2, bias2), minus_one));
+            }
+            if (_mm_movemask_epi8(mask) == 0) {
+                continue;
+            }
+
+            __m128 center_x = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_center);
+            __m128 inv_w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(inv_w_dx, center_x), _mm_mul_ps(inv_w_dy, center_y)), inv_w_c);
+            __m128 z_ndc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(z_dx, center_x), _mm_mul_ps(z_dy, center_y)), z_c);
+
+            __m128 pass = _mm_castsi128_ps(mask);
+            pass = _mm_and_ps(pass, _mm_cmpge_ps(_mm_and_ps(inv_w, abs_mask), inv_w_epsilon));
+            pass = _mm_and_ps(pass, _mm_and_ps(_mm_cmpge_ps(z_ndc, z_min), _mm_cmple_ps(z_ndc, z_max)));
+
+            int pass_bits = depthTestAndWriteSse2(y * screenWidth + x, z_ndc, pass);
+            if (pass_bits == 0) {
+                continue;
+            }
+
+            for (int k = 0; k < 4; ++k) {
+                if (pass_bits & (1 << k)) {
+                    shadeVisible(x + k, y);
+                }
+            }
+        }
+    }
+}
+#endif
+
+// Rasterizes one triangle with the given shader; v*_varyings hold Shader::varyingCount floats
+template <typename Shader>
+void rasterizeTriangle(
+    const glm::vec4& v0_clip, const glm::vec4& v1_clip, const glm::vec4& v2_clip,
+    const float* v0_varyings, const float* v1_varyings, const float* v2_varyings,
+    const ScreenRect& scissor = fullScreenRect,
+    CullStats* stats = nullptr,
+    int visibility_id = emptyVisibilityId,
+    bool face_culled = false) {
+
+    if (!passesProjectionTest(v0_clip, v1_clip, v2_clip, stats)) {
+        return;
+    }
+
+    glm::vec2 v0_screen = clipToScreen(v0_clip);
+    glm::vec2 v1_screen = clipToScreen(v1_clip);
+    glm::vec2 v2_screen = clipToScreen(v2_clip);
+
+    float area = edgeFunction(v0_screen, v1_screen, v2_screen);
+
+    if (!face_culled && !passesFaceCull(area, stats)) {
+        return;
+    }
+
+    // Coverage is tested against positive-area triangles; a negative-area triangle that survived
+    // culling is rasterized with its winding flipped, without being face culled a second time.
+    if (area < 0.0f) {
+        rasterizeTriangle<Shader>(
+            v0_clip, v2_clip, v1_clip,
+            v0_varyings, v2_varyings, v1_varyings,
+            scissor, nullptr, visibility_id, true);
+        return;
+    }
+
+    // On-screen corner of the bounding box, independent of the scissor
+    int originX = static_cast<int>(std::max(0.0f, std::min({ v0_screen.x, v1_screen.x, v2_screen.x })));
+    int originY = static_cast<int>(std::max(0.0f, std::min({ v0_screen.y, v1_screen.y, v2_screen.y })));
+
+    int minX = std::max(scissor.minX, originX);
+    int maxX = static_cast<int>(std::min(static_cast<float>(scissor.maxX), std::ceil(std::max({ v0_screen.x, v1_screen.x, v2_screen.x }))));
+    int minY = std::max(scissor.minY, originY);
+    int maxY = static_cast<int>(std::min(static_cast<float>(scissor.maxY), std::ceil(std::max({ v0_screen.y, v1_screen.y, v2_screen.y }))));
+
+    const int varying_count = Shader::varyingCount;
+    TrianglePlanes<varying_count> planes;
+
+    // Runs for a pixel that has already passed (and updated) the depth test: records the triangle
+    // in the visibility buffer, or queues it in shade_batch with perspective-correct
+    // interpolation. The batch is flushed when full and by recordFragments, before this triangle
+    // returns; a triangle covers each pixel once, so deferring its color writes is safe.
+    bool depth_written = false;
+    int64_t fragments_passed = 0;
+    PixelBatch<varying_count> shade_batch;
+    shade_batch.count = 0;
+    auto shadeVisibleFragment = [&](int x, int y) {
+        depth_written = true;
+        ++fragments_passed;
+        if (visibility_id != emptyVisibilityId) {
+            visibilityBuffer[y * screenWidth + x] = visibility_id;
+            return;
+        }
+
+        float varyings[varying_count];
+        interpolateVaryings(planes, x, y, varyings);
+        addPixelToBatch<Shader>(shade_batch, x, y, varyings);
+    };
+
+    // Shades what is left in the batch and publishes this call's fragment count; called on every
+    // exit after traversal
+    auto recordFragments = [&]() {
+        flushPixelBatch<Shader>(shade_batch);
+        g_shadingStats.depth_passed += fragments_passed;
+        if (visibility_id == emptyVisibilityId) {
+            g_shadingStats.shaded += fragments_passed;
+        }
+    };
+
+    // Depth test, perspective-correct interpolation and shading for one covered pixel.
+    auto shadeFragment = [&](int x, int y) {
+        float px = static_cast<float>(x) + 0.5f;
+        float py = static_cast<float>(y) + 0.5f;
+
+        if (std::abs(planes.inv_w.at(px, py)) < std::numeric_limits<float>::epsilon()) {
+            return;
+        }
+        float z_ndc_interpolated = planes.z_ndc.at(px, py);
+
+        if (z_ndc_interpolated < depthNdcMin - 1e-5f || z_ndc_interpolated > 1.0f + 1e-5f) {
+            return;
+        }
+
+        if (depthTestAndWrite(y * screenWidth + x, z_ndc_interpolated)) {
+            shadeVisibleFragment(x, y);
+        }
+    };
+
+    if (rasterMode == RasterMode::FixedPoint && isSubpixelRepresentable(v0_screen, v1_screen, v2_screen)) {
+        glm::ivec2 v0_fixed = snapToSubpixel(v0_screen);
+        glm::ivec2 v1_fixed = snapToSubpixel(v1_screen);
+        glm::ivec2 v2_fixed = snapToSubpixel(v2_screen);
+
+        FixedEdgeEquation f0(v1_fixed, v2_fixed);
+        FixedEdgeEquation f1(v2_fixed, v0_fixed);
+        FixedEdgeEquation f2(v0_fixed, v1_fixed);
+
+        // Snapping can flip or collapse a sliver triangle, so the area is recomputed on the grid
+        int64_t area_fixed = f2.evaluate(v2_fixed.x, v2_fixed.y);
+        if (area_fixed <= 0) {
+            return;
+        }
+
+        int bboxMinX = std::min({ v0_fixed.x, v1_fixed.x, v2_fixed.x }) >> subpixelBits;
+        int bboxMaxX = std::max({ v0_fixed.x, v1_fixed.x, v2_fixed.x }) >> subpixelBits;
+        int bboxMinY = std::min({ v0_fixed.y, v1_fixed.y, v2_fixed.y }) >> subpixelBits;
+        int bboxMaxY = std::max({ v0_fixed.y, v1_fixed.y, v2_fixed.y }) >> subpixelBits;
+        minX = std::max(scissor.minX, bboxMinX);
+        maxX = std::min(scissor.maxX, bboxMaxX);
+        minY = std::max(scissor.minY, bboxMinY);
+        maxY = std::min(scissor.maxY, bboxMaxY);
+
+        // Judged on the unclipped box: a large triangle cut down by the scissor is not small
+        bool small_triangle = useSmallTrianglePath &&
+            bboxMaxX - bboxMinX < smallTriangleStamp && bboxMaxY - bboxMinY < smallTriangleStamp;
+        if (small_triangle && (minX > maxX || minY > maxY || !coversAnyPixelCenter(f0, f1, f2, minX, minY, maxX, maxY))) {
+            return;
+        }
+        clearTilesOnFirstWrite(minX, minY, maxX, maxY);
+
+        // Interpolation uses the snapped positions, matching the coverage
+        planes = setupTrianglePlanes<varying_count>(
+            glm::vec2(v0_fixed) / static_cast<float>(subpixelScale),
+            glm::vec2(v1_fixed) / static_cast<float>(subpixelScale),
+            glm::vec2(v2_fixed) / static_cast<float>(subpixelScale),
+            v0_clip, v1_clip, v2_clip, v0_varyings, v1_varyings, v2_varyings);
+
+#ifdef RASTER_HAS_SSE2
+        // The kernel evaluates whole 4-pixel groups, so the range check covers the aligned span;
+        // a small triangle's edge values always fit
+        bool use_simd_kernel = useSimdRasterKernel && (small_triangle || (
+            fitsInt32Lanes(f0, (minX & ~3), minY, (maxX | 3), maxY) &&
+            fitsInt32Lanes(f1, (minX & ~3), minY, (maxX | 3), maxY) &&
+            fitsInt32Lanes(f2, (minX & ~3), minY, (maxX | 3), maxY)));
+#endif
+
+        // Walks the pixels of [x0, x1] x [y0, y1]. With test_coverage == false the caller has
+        // proven the whole rectangle inside the triangle and the edge tests are skipped.
+        auto walkPixels = [&](int x0, int y0, int x1, int y1, bool test_coverage) {
+#ifdef RASTER_HAS_SSE2
+            if (use_simd_kernel) {
+                walkPixelsSse2(f0, f1, f2, planes, x0, y0, x1, y1, test_coverage, shadeVisibleFragment);
+                return;
+            }
+#endif
+            // Pixel centers sit half a pixel into the subpixel grid
+            int64_t px_start = (static_cast<int64_t>(x0) << subpixelBits) + subpixelScale / 2;
+            int64_t py_start = (static_cast<int64_t>(y0) << subpixelBits) + subpixelScale / 2;
+            int64_t w0_row = f0.evaluate(px_start, py_start);
+            int64_t w1_row = f1.evaluate(px_start, py_start);
+            int64_t w2_row = f2.evaluate(px_start, py_start);
+
+            for (int y = y0; y <= y1; ++y, w0_row += f0.stepY, w1_row += f1.stepY, w2_row += f2.stepY) {
+                int64_t w0_edge = w0_row;
+                int64_t w1_edge = w1_row;
+                int64_t w2_edge = w2_row;
+
+                for (int x = x0; x <= x1; ++x, w0_edge += f0.stepX, w1_edge += f1.stepX, w2_edge += f2.stepX) {
+                    // Biased edges turn ">= 0" into "> 0" for edges that are not top or left
+                    if (!test_coverage || ((w0_edge + f0.bias) >= 0 && (w1_edge + f1.bias) >= 0 && (w2_edge + f2.bias) >= 0)) {
+                        shadeFragment(x, y);
+                    }
+                }
+            }
+        };
+
+        // A small triangle is walked as a whole; the blocks it wrote to still get their
+        // hierarchical-Z entries refreshed
+        if (small_triangle) {
+            expandDepthBlocks(minX, minY, maxX, maxY);
+            walkPixels(minX, minY, maxX, maxY, true);
+            if (useHierarchicalZ && depth_written) {
+                for (int hy = minY / coarseBlockSize; hy <= maxY / coarseBlockSize; ++hy) {
+                    for (int hx = minX / coarseBlockSize; hx <= maxX / coarseBlockSize; ++hx) {
+                        updateHiZBlock(hx, hy);
+                    }
+                }
+            }
+            recordFragments();
+            return;
+        }
+
+        if (!useHierarchicalTraversal) {
+            expandDepthBlocks(minX, minY, maxX, maxY);
+            walkPixels(minX, minY, maxX, maxY, true);
+            recordFragments();
+            return;
+        }
+
+        // Whole-triangle test against the farthest depth under the bounding box
+        if (useHierarchicalZ &&
+            nearestPlaneDepth(planes.z_ndc, minX, minY, maxX, maxY) - hiZTolerance >= farthestHiZ(minX, minY, maxX, maxY)) {
+            return;
+        }
+
+        // Coarse pass over screen-aligned blocks. The edge functions are linear, so their extremes
+        // over a block's pixel centers are reached at its corners: a block is rejected when one edge
+        // is negative at all four corners and trivially accepted when every edge is non-negative at all of them.
+        for (int by = minY & ~(coarseBlockSize - 1); by <= maxY; by += coarseBlockSize) {
+            for (int bx = minX & ~(coarseBlockSize - 1); bx <= maxX; bx += coarseBlockSize) {
+                int x0 = std::max(bx, minX);
+                int y0 = std::max(by, minY);
+                int x1 = std::min(bx + coarseBlockSize - 1, maxX);
+                int y1 = std::min(by + coarseBlockSize - 1, maxY);
+
+                int64_t px0 = (static_cast<int64_t>(x0) << subpixelBits) + subpixelScale / 2;
+                int64_t py0 = (static_cast<int64_t>(y0) << subpixelBits) + subpixelScale / 2;
+
+                bool rejected = false;
+                bool accepted = true;
+                const FixedEdgeEquation* edges[3] = { &f0, &f1, &f2 };
+                for (const FixedEdgeEquation* f : edges) {
+                    int64_t w_corner = f->evaluate(px0, py0) + f->bias;
+                    int64_t dx = f->stepX * (x1 - x0);
+                    int64_t dy = f->stepY * (y1 - y0);
+                    int64_t w_min = w_corner + std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0);
+                    int64_t w_max = w_corner + std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0);
+                    if (w_max < 0) {
+                        rejected = true;
+                        break;
+                    }
+                    if (w_min < 0) {
+                        accepted = false;
+                    }
+                }
+
+                if (rejected) {
+                    continue;
+                }
+
+                int hi_z_index = (by / coarseBlockSize) * hiZWidth + bx / coarseBlockSize;
+                if (useHierarchicalZ && nearestPlaneDepth(planes.z_ndc, x0, y0, x1, y1) - hiZTolerance >= hiZBuffer[hi_z_index]) {
+                    continue;
+                }
+
+                // A whole block covered by a triangle in front of all it holds becomes that
+                // triangle's plane; every pixel passes, so none is depth tested
+                DepthBlock& depth_block = depthBlocks[hi_z_index];
+                if (useCompressedDepth && accepted &&
+                    x0 == bx && y0 == by && x1 == bx + coarseBlockSize - 1 && y1 == by + coarseBlockSize - 1 &&
+                    replacesDepthBlock(depth_block, planes, x0, y0)) {
+                    depth_block.state = DepthBlockState::Plane;
+                    depth_block.z_ndc = planes.z_ndc;
+                    depth_block.nearest = nearestPlaneDepth(planes.z_ndc, x0, y0, x1, y1);
+                    hiZBuffer[hi_z_index] = farthestPlaneDepth(planes.z_ndc, x0, y0, x1, y1);
+                    for (int y = y0; y <= y1; ++y) {
+                        for (int x = x0; x <= x1; ++x) {
+                            shadeVisibleFragment(x, y);
+                        }
+                    }
+                    continue;
+                }
+                if (useCompressedDepth) {
+                    expandDepthBlock(bx / coarseBlockSize, by / coarseBlockSize);
+                }
+
+                depth_written = false;
+                walkPixels(x0, y0, x1, y1, !accepted);
+                if (useHierarchicalZ && depth_written) {
+                    updateHiZBlock(bx / coarseBlockSize, by / coarseBlockSize);
+                }
+            }
+        }
+        recordFragments();
+        return;
+    }
+
+    planes = setupTrianglePlanes<varying_count>(v0_screen, v1_screen, v2_screen,
+        v0_clip, v1_clip, v2_clip, v0_varyings, v1_varyings, v2_varyings);
+
+    EdgeEquation e0(v1_screen, v2_screen);
+    EdgeEquation e1(v2_screen, v0_screen);
+    EdgeEquation e2(v0_screen, v1_screen);
+
+    clearTilesOnFirstWrite(minX, minY, maxX, maxY);
+    expandDepthBlocks(minX, minY, maxX, maxY);
+
+    // The float edge values are stepped from the on-screen bounding box corner rather than from the
+    // scissor, so a tile sees the same rounding as the full-screen walk; rows and columns before
+    // the scissor are only stepped over.
+    glm::vec2 p_start = { static_cast<float>(originX) + 0.5f, static_cast<float>(originY) + 0.5f };
+    float w0_row = e0.evaluate(p_start);
+    float w1_row = e1.evaluate(p_start);
+    float w2_row = e2.evaluate(p_start);
+
+    for (int y = originY; y <= maxY; ++y, w0_row += e0.B, w1_row += e1.B, w2_row += e2.B) {
+        if (y < minY) {
+            continue;
+        }
+        float w0_edge = w0_row;
+        float w1_edge = w1_row;
+        float w2_edge = w2_row;
+
+        for (int x = originX; x <= maxX; ++x, w0_edge += e0.A, w1_edge += e1.A, w2_edge += e2.A) {
+            if (x < minX) {
+                continue;
+            }
+            if (rasterMode == RasterMode::Reference) {
+                glm::vec2 p = { static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f };
+
+                w0_edge = edgeFunction(v1_screen, v2_screen, p);
+                w1_edge = edgeFunction(v2_screen, v0_screen, p);
+                w2_edge = edgeFunction(v0_screen, v1_screen, p);
+            }
+
+            if (w0_edge >= 0 && w1_edge >= 0 && w2_edge >= 0) {
+                shadeFragment(x, y);
+            }
+        }
+    }
+    recordFragments();
+}
+
+// Second visibility-buffer pass over one tile: shades every covered pixel of rect once, with the
+// planes of the triangle that won its depth test, after beginTile has been given the 1/w range
+// of those pixels
+template <typename Shader>
+void resolveVisibilityBuffer(const std::vector<TrianglePlanes<Shader::varyingCount>>& trianglePlanes, const ScreenRect& rect) {
+    // The tile's depth range over the pixels to shade; 1/w is largest at the nearest
+    float max_inv_w = 0.0f;
+    float min_inv_w = std::numeric_limits<float>::max();
+    for (int y = rect.minY; y <= rect.maxY; ++y) {
+        for (int x = rect.minX; x <= rect.maxX; ++x) {
+            int id = visibilityBuffer[y * screenWidth + x];
+            if (id != emptyVisibilityId) {
+                float inv_w = trianglePlanes[id].inv_w.at(static_cast<float>(x) + 0.5f, static_cast<float>(y) + 0.5f);
+                max_inv_w = std::max(max_inv_w, inv_w);
+                min_inv_w = std::min(min_inv_w, inv_w);
+            }
+        }
+    }
+    if (max_inv_w == 0.0f) {
+        return;
+    }
+    Shader::beginTile(tileAt(rect.minX, rect.minY), 1.0f / max_inv_w, 1.0f / min_inv_w);
+
+    PixelBatch<Shader::varyingCount> batch;
+    batch.count = 0;
+    int64_t shaded = 0;
+    for (int y = rect.minY; y <= rect.maxY; ++y) {
+        for (int x = rect.minX; x <= rect.maxX; ++x) {
+            int id = visibilityBuffer[y * screenWidth + x];
+            if (id == emptyVisibilityId) {
+                continue;
+            }
+
+            float varyings[Shader::varyingCount];
+            interpolateVaryings(trianglePlanes[id], x, y, varyings);
+            addPixelToBatch<Shader>(batch, x, y, varyings);
+            ++shaded;
+        }
+    }
+    flushPixelBatch<Shader>(batch);
+    g_shadingStats.shaded += shaded;
+}
+
+// Sorts triangles into per-tile lists, preserving submission order inside every tile.
+// Runs the same cull stages and bounding box as rasterizeTriangle, so a triangle lands in
+// exactly the tiles it could write to; the cull counts are recorded here, once per triangle.
+template <int VaryingCount>
+void binTriangles(const std::vector<ClipTriangle<VaryingCount>>& triangles, std::vector<std::vector<int>>& tileBins, CullStats* stats) {
+    tileBins.assign(tileCountX * tileCountY, std::vector<int>());
+
+    for (int i = 0; i < static_cast<int>(triangles.size()); ++i) {
+        const glm::vec4* v_clip = triangles[i].v_clip;
+        if (!passesProjectionTest(v_clip[0], v_clip[1], v_clip[2], stats)) {
+            continue;
+        }
+
+        glm::vec2 v0_screen = clipToScreen(v_clip[0]);
+        glm::vec2 v1_screen = clipToScreen(v_clip[1]);
+        glm::vec2 v2_screen = clipToScreen(v_clip[2]);
+        if (!passesFaceCull(edgeFunction(v0_screen, v1_screen, v2_screen), stats)) {
+            continue;
+        }
+
+        float minX = std::max(0.0f, std::min({ v0_screen.x, v1_screen.x, v2_screen.x }));
+        float maxX = std::min(static_cast<float>(screenWidth - 1), std::ceil(std::max({ v0_screen.x, v1_screen.x, v2_screen.x })));
+        float minY = std::max(0.0f, std::min({ v0_screen.y, v1_screen.y, v2_screen.y }));
+        float maxY = std::min(static_cast<float>(screenHeight - 1), std::ceil(std::max({ v0_screen.y, v1_screen.y, v2_screen.y })));
+        if (minX > maxX || minY > maxY) {
+            continue;
+        }
+
+        int tileMinX = static_cast<int>(minX) / tileSize;
+        int tileMaxX = static_cast<int>(maxX) / tileSize;
+        int tileMinY = static_cast<int>(minY) / tileSize;
+        int tileMaxY = static_cast<int>(maxY) / tileSize;
+        for (int ty = tileMinY; ty <= tileMaxY; ++ty) {
+            for (int tx = tileMinX; tx <= tileMaxX; ++tx) {
+                tileBins[ty * tileCountX + tx].push_back(i);
+            }
+        }
+    }
+}
+
+// Rasterizes every tile's bin on a pool of worker threads. Workers pull tile indices from a
+// shared counter; each tile is owned by a single worker, so the framebuffer and depth buffer
+// are written without locks. Which worker gets a tile never matters: a tile's result depends
+// only on its bin, which is replayed in primitive-ID order.
+// In visibility-buffer mode the tile is resolved as soon as its bin is done, while its pixels
+// are still in cache; trianglePlanes is only read in that mode.
+template <typename Shader>
+void renderTiles(const std::vector<ClipTriangle<Shader::varyingCount>>& triangles, const std::vector<std::vector<int>>& tileBins,
+    const std::vector<TrianglePlanes<Shader::varyingCount>>& trianglePlanes) {
+    unsigned int thread_count = renderThreadCount != 0 ? renderThreadCount : std::thread::hardware_concurrency();
+    thread_count = std::max(1u, std::min(thread_count, static_cast<unsigned int>(tileBins.size())));
+
+    std::atomic<int> next_tile(0);
+    auto worker = [&]() {
+        for (int tile = next_tile++; tile < static_cast<int>(tileBins.size()); tile = next_tile++) {
+            ScreenRect tile_rect = tileRect(tile);
+
+            // Shading during rasterization only knows the tile's triangles, not its final depth
+            if (!useVisibilityBuffer && !tileBins[tile].empty()) {
+                float nearest_w = std::numeric_limits<float>::max();
+                float farthest_w = 0.0f;
+                for (int tri_index : tileBins[tile]) {
+                    for (const glm::vec4& v_clip : triangles[tri_index].v_clip) {
+                        nearest_w = std::min(nearest_w, v_clip.w);
+                        farthest_w = std::max(farthest_w, v_clip.w);
+                    }
+                }
+                Shader::beginTile(tile, nearest_w, farthest_w);
+            }
+
+            for (int tri_index : tileBins[tile]) {
+                const ClipTriangle<Shader::varyingCount>& tri = triangles[tri_index];
+                rasterizeTriangle<Shader>(
+                    tri.v_clip[0], tri.v_clip[1], tri.v_clip[2],
+                    tri.varyings[0], tri.varyings[1], tri.varyings[2],
+                    tile_rect,
+                    nullptr,
+                    useVisibilityBuffer ? tri_index : emptyVisibilityId
+                );
+            }
+
+            if (useVisibilityBuffer && !tileCleared[tile]) {
+                resolveVisibilityBuffer<Shader>(trianglePlanes, tile_rect);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < thread_count; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+// Post-transform vertex: every vertex of gVertexBuffer is transformed once and triangles read
+// their corners from the result by index
+struct TransformedVertex {
+    glm::vec4 v_clip;
+    glm::vec3 v_world;
+    glm::vec3 n_world_norm;
+};
+
+// Model-space vertex positions in structure-of-arrays layout, the input of the vertex stage
+struct VertexStreams {
+    std::vector<float> x, y, z;
+};
+
+VertexStreams makeVertexStreams();
+
+std::vector<TransformedVertex> transformVertices(const VertexStreams& streams, const glm::mat4& mvpMatrix);
+
+// Vertex stage: the clip position and the shader's varyings of every transformed vertex
+template <typename Shader>
+std::vector<ClipVertex<Shader::varyingCount>> shadeVertices(const std::vector<TransformedVertex>& vertices) {
+    std::vector<ClipVertex<Shader::varyingCount>> shaded(vertices.size());
+    for (size_t k = 0; k < vertices.size(); ++k) {
+        shaded[k].v_clip = vertices[k].v_clip;
+        Shader::vertex(vertices[k].v_world, vertices[k].n_world_norm, shaded[k].varyings);
+    }
+    return shaded;
+}
+
+// Draws the frame buffer over a window just cleared to black, the frame buffer's clear color.
+// With lazy clears only tiles that were written are uploaded, each as a sub-rectangle of
+// frameBuffer at its own window position.
+void presentFrameBuffer();
+
+// Draws gIndexBuffer with the shader: every vertex is transformed and shaded once, meshlets are
+// culled, each triangle is clipped and fanned, and the fan is rasterized as it is submitted or
+// handed to the tiled and visibility-buffer backends. streams holds the mesh's model-space
+// positions, and g_modelMatrix and g_sphere_center_world place it in the world.
+template <typename Shader>
+void drawMesh(const VertexStreams& streams, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+    glm::mat4 mvpMatrix = projectionMatrix * viewMatrix * g_modelMatrix;
+    const int varying_count = Shader::varyingCount;
+    std::vector<ClipVertex<varying_count>> shadedVertices = shadeVertices<Shader>(transformVertices(streams, mvpMatrix));
+    ModelSpaceView modelSpaceView = makeModelSpaceView(mvpMatrix, viewMatrix * g_modelMatrix);
+
+    std::vector<ClipTriangle<varying_count>> clipTriangles;
+    if (useTiledRenderer || useVisibilityBuffer) {
+        clipTriangles.reserve(gNumTriangles);
+    }
+
+    // Without meshlets the whole index buffer is drawn as one unculled range
+    const bool has_meshlets = gNumMeshlets > 0;
+    const Meshlet whole_mesh = { 0, gNumTriangles, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), 0.0f };
+    for (int m = 0; m < (has_meshlets ? gNumMeshlets : 1); ++m) {
+        const Meshlet& meshlet = has_meshlets ? gMeshletBuffer[m] : whole_mesh;
+        if (useMeshletCulling && has_meshlets) {
+            if (!isMeshletVisible(meshlet, modelSpaceView, &g_cullStats)) {
+                continue;
+            }
+            if (!useTiledRenderer && !useVisibilityBuffer && isMeshletOccluded(meshlet, mvpMatrix)) {
+                ++g_cullStats.meshlet_occluded;
+                continue;
+            }
+        }
+
+        for (int i = meshlet.firstTriangle; i < meshlet.firstTriangle + meshlet.triangleCount; ++i) {
+            int k0 = gIndexBuffer[3 * i + 0];
+            int k1 = gIndexBuffer[3 * i + 1];
+            int k2 = gIndexBuffer[3 * i + 2];
+
+            ClipVertex<varying_count> polygon[maxClipVertices] = {
+                shadedVertices[k0],
+                shadedVertices[k1],
+                shadedVertices[k2]
+            };
+            Shader::primitive(polygon[0].varyings, polygon[1].varyings, polygon[2].varyings);
+            int polygon_size = clipTriangle(polygon, &g_cullStats);
+
+            // Fan the clipped polygon back into triangles around its first vertex
+            for (int k = 1; k + 1 < polygon_size; ++k) {
+                const ClipVertex<varying_count>& a = polygon[0];
+                const ClipVertex<varying_count>& b = polygon[k];
+                const ClipVertex<varying_count>& c = polygon[k + 1];
+
+                if (useTiledRenderer || useVisibilityBuffer) {
+                    clipTriangles.push_back(makeClipTriangle(a, b, c));
+                    continue;
+                }
+
+                rasterizeTriangle<Shader>(
+                    a.v_clip, b.v_clip, c.v_clip,
+                    a.varyings, b.varyings, c.varyings,
+                    fullScreenRect,
+                    &g_cullStats,
+                    emptyVisibilityId
+                );
+            }
+        }
+    }
+
+    std::vector<TrianglePlanes<varying_count>> trianglePlanes;
+    if (useVisibilityBuffer) {
+        trianglePlanes.reserve(clipTriangles.size());
+        for (const ClipTriangle<varying_count>& tri : clipTriangles) {
+            trianglePlanes.push_back(setupTrianglePlanes(tri));
+        }
+    }
+
+    if (useTiledRenderer) {
+        std::vector<std::vector<int>> tileBins;
+        binTriangles(clipTriangles, tileBins, &g_cullStats);
+        renderTiles<Shader>(clipTriangles, tileBins, trianglePlanes);
+    }
+    else if (useVisibilityBuffer) {
+        for (int i = 0; i < static_cast<int>(clipTriangles.size()); ++i) {
+            const ClipTriangle<varying_count>& tri = clipTriangles[i];
+            rasterizeTriangle<Shader>(
+                tri.v_clip[0], tri.v_clip[1], tri.v_clip[2],
+                tri.varyings[0], tri.varyings[1], tri.varyings[2],
+                fullScreenRect,
+                &g_cullStats,
+                i
+            );
+        }
+        for (int tile = 0; tile < tileCountX * tileCountY; ++tile) {
+            if (!tileCleared[tile]) {
+                resolveVisibilityBuffer<Shader>(trianglePlanes, tileRect(tile));
+            }
+        }
+    }
+}
+
+// Prints the cull, fragment and depth-block counters of the frame
+void printFrameStats();
+
+#endif // RENDER_PIPELINE_H
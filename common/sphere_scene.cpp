@@ -0,0 +1,500 @@
+//
+//  sphere_scene.cpp
+//  Rasterizer based on the provided sphere_scene.c
+//
+//
+
+#include <stdio.h>
+#include <math.h>
+#include <glm/vec3.hpp> // Include GLM for vec3 type
+#include <glm/geometric.hpp>
+#include "sphere_scene.h"
+
+// Global variables
+int         gNumVertices = 0;        // Number of 3D vertices.
+int         gNumTriangles = 0;        // Number of triangles.
+int* gIndexBuffer = nullptr;  // Vertex indices for the triangles.
+glm::vec3* gVertexBuffer = nullptr;  // Vertex coordinates array (using glm::vec3)
+int         gNumMeshlets = 0;        // Number of meshlets.
+Meshlet* gMeshletBuffer = nullptr;   // Triangle clusters over gIndexBuffer.
+
+// Entries of the post-transform vertex cache the index order is optimized for
+const int vertexCacheSize = 16;
+// Triangles per meshlet
+const int meshletMaxTriangles = 64;
+
+// Function to create the sphere geometry
+void create_scene()
+{
+    // Define sphere parameters (resolution)
+    int width = 32; // Number of divisions around the equator
+    int height = 16; // Number of divisions from pole to pole
+
+    float theta, phi;
+    int t; // Vertex counter
+
+    // Calculate total number of vertices and triangles
+    gNumVertices = (height - 2) * width + 2; // vertices in the middle + 2 poles
+    gNumTriangles = (height - 2) * (width - 1) * 2; // triangles in the middle strips
+
+    // 1. Allocate the vertex buffer array
+    gVertexBuffer = new glm::vec3[gNumVertices];
+    if (!gVertexBuffer) {
+        fprintf(stderr, "Error allocating memory for vertex buffer\n");
+        return;
+    }
+
+    // Allocate the index buffer array
+    // Note: 3 indices per triangle
+    gIndexBuffer = new int[3 * gNumTriangles];
+    if (!gIndexBuffer) {
+        fprintf(stderr, "Error allocating memory for index buffer\n");
+        delete[] gVertexBuffer; // Clean up previously allocated memory
+        gVertexBuffer = nullptr;
+        return;
+    }
+
+
+    t = 0; // Initialize vertex index counter
+
+    // Generate vertices for the main body of the sphere (excluding poles)
+    for (int j = 1; j < height - 1; ++j) // Iterate through latitude lines
+    {
+        for (int i = 0; i < width; ++i) // Iterate through longitude lines
+        {
+            // Calculate spherical coordinates (theta: polar angle, phi: azimuthal angle)
+            // Note: M_PI might require defining _USE_MATH_DEFINES before including math.h/cmath on some compilers
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+            theta = (float)j / (height - 1) * M_PI;        // Angle from the positive Y axis
+            phi = (float)i / (width - 1) * M_PI * 2;    // Angle around the Y axis
+
+            // Convert spherical coordinates to Cartesian coordinates (unit sphere)
+            float   x = sinf(theta) * cosf(phi);
+            float   y = cosf(theta);
+            float   z = -sinf(theta) * sinf(phi); // Negative Z to match common conventions if needed
+
+            // 2. Set vertex t in the vertex array to {x, y, z}.
+            gVertexBuffer[t] = glm::vec3(x, y, z);
+            t++; // Increment vertex index
+        }
+    }
+
+    // Add the North Pole vertex
+    // 3. Set vertex t in the vertex array to {0, 1, 0}.
+    gVertexBuffer[t] = glm::vec3(0.0f, 1.0f, 0.0f);
+    t++; // Increment vertex index
+
+    // Add the South Pole vertex
+    // 4. Set vertex t in the vertex array to {0, -1, 0}.
+    gVertexBuffer[t] = glm::vec3(0.0f, -1.0f, 0.0f);
+    t++; // Increment vertex index
+
+    // --- Generate the index buffer ---
+    t = 0; // Reset counter for index buffer population
+
+    // Generate indices for the main body triangles (quad strips)
+    for (int j = 0; j < height - 3; ++j) // Iterate through latitude strips
+    {
+        for (int i = 0; i < width - 1; ++i) // Iterate through longitude quads
+        {
+            // Triangle 1 of the quad
+            gIndexBuffer[t++] = j * width + i;              // Bottom-left vertex
+            gIndexBuffer[t++] = (j + 1) * width + (i + 1);  // Top-right vertex
+            gIndexBuffer[t++] = j * width + (i + 1);        // Bottom-right vertex
+
+            // Triangle 2 of the quad
+            gIndexBuffer[t++] = j * width + i;              // Bottom-left vertex
+            gIndexBuffer[t++] = (j + 1) * width + i;        // Top-left vertex
+            gIndexBuffer[t++] = (j + 1) * width + (i + 1);  // Top-right vertex
+        }
+    }
+
+    // Generate indices for the triangles connecting to the poles (fans)
+    int northPoleIndex = (height - 2) * width; // Index of the North Pole vertex
+    int southPoleIndex = northPoleIndex + 1; // Index of the South Pole vertex
+
+    // Triangles connecting the top strip to the North Pole
+    for (int i = 0; i < width - 1; ++i)
+    {
+        gIndexBuffer[t++] = northPoleIndex; // North Pole
+        gIndexBuffer[t++] = i;              // Vertex on the top strip
+        gIndexBuffer[t++] = i + 1;          // Next vertex on the top strip
+    }
+
+    // Triangles connecting the bottom strip to the South Pole
+    int bottomStripStart = (height - 3) * width;
+    for (int i = 0; i < width - 1; ++i)
+    {
+        gIndexBuffer[t++] = southPoleIndex;             // South Pole
+        gIndexBuffer[t++] = bottomStripStart + (i + 1); // Next vertex on the bottom strip
+        gIndexBuffer[t++] = bottomStripStart + i;       // Vertex on the bottom strip
+    }
+
+    // The index buffer has now been generated.
+    // To determine the vertices of triangle i (0 <= i < gNumTriangles):
+    // k0 = gIndexBuffer[3*i + 0];
+    // k1 = gIndexBuffer[3*i + 1];
+    // k2 = gIndexBuffer[3*i + 2];
+    // The vertices are gVertexBuffer[k0], gVertexBuffer[k1], and gVertexBuffer[k2].
+
+    // Reorder the triangles for the post-transform vertex cache and report the effect
+    float acmr_before, atvr_before, acmr_after, atvr_after;
+    if (printRenderStats) {
+        simulate_vertex_cache(gIndexBuffer, gNumTriangles, gNumVertices, vertexCacheSize, &acmr_before, &atvr_before);
+    }
+    optimize_index_order(gIndexBuffer, gNumTriangles, gNumVertices, vertexCacheSize);
+    build_meshlets(meshletMaxTriangles);
+    if (printRenderStats) {
+        simulate_vertex_cache(gIndexBuffer, gNumTriangles, gNumVertices, vertexCacheSize, &acmr_after, &atvr_after);
+        printf("Index order (FIFO cache of %d): ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+            vertexCacheSize, acmr_before, acmr_after, atvr_before, atvr_after);
+    }
+}
+
+// Frees the buffers allocated by create_scene
+void delete_scene()
+{
+    delete[] gVertexBuffer;
+    delete[] gIndexBuffer;
+    delete[] gMeshletBuffer;
+    gVertexBuffer = nullptr;
+    gIndexBuffer = nullptr;
+    gMeshletBuffer = nullptr;
+    gNumVertices = 0;
+    gNumTriangles = 0;
+    gNumMeshlets = 0;
+}
+
+// Pops the dead-end stack, or scans forward for a vertex that still has live triangles
+static int skipDeadEnd(const int* liveTriangles, int* deadEndStack, int* deadEndSize, int* cursor, int numVertices)
+{
+    // Recently used vertices that still have triangles left
+    while (*deadEndSize > 0) {
+        int v = deadEndStack[--(*deadEndSize)];
+        if (liveTriangles[v] > 0) {
+            return v;
+        }
+    }
+
+    // Otherwise the next vertex in input order that still has triangles left
+    while (*cursor < numVertices) {
+        if (liveTriangles[*cursor] > 0) {
+            return *cursor;
+        }
+        ++(*cursor);
+    }
+    return -1;
+}
+
+void optimize_index_order(int* indices, int numTriangles, int numVertices, int cacheSize)
+{
+    if (numTriangles <= 0 || numVertices <= 0) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency in compressed rows
+    int* liveTriangles = new int[numVertices]();
+    for (int k = 0; k < 3 * numTriangles; ++k) {
+        liveTriangles[indices[k]]++;
+    }
+    int* adjacencyStart = new int[numVertices + 1];
+    adjacencyStart[0] = 0;
+    for (int v = 0; v < numVertices; ++v) {
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    }
+    int* adjacency = new int[3 * numTriangles];
+    int* fill = new int[numVertices];
+    for (int v = 0; v < numVertices; ++v) {
+        fill[v] = adjacencyStart[v];
+    }
+    for (int tri = 0; tri < numTriangles; ++tri) {
+        for (int c = 0; c < 3; ++c) {
+            int v = indices[3 * tri + c];
+            adjacency[fill[v]++] = tri;
+        }
+    }
+
+    int* cacheTime = new int[numVertices]();
+    bool* emitted = new bool[numTriangles]();
+    int* deadEndStack = new int[3 * numTriangles];
+    int deadEndSize = 0;
+    int* candidates = new int[3 * numTriangles];
+    int* output = new int[3 * numTriangles];
+    int outputSize = 0;
+
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fanning = 0;
+    while (fanning >= 0) {
+        // Emit every remaining triangle around the fanning vertex
+        int candidateCount = 0;
+        for (int a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; ++a) {
+            int tri = adjacency[a];
+            if (emitted[tri]) {
+                continue;
+            }
+            for (int c = 0; c < 3; ++c) {
+                int v = indices[3 * tri + c];
+                output[outputSize++] = v;
+                deadEndStack[deadEndSize++] = v;
+                candidates[candidateCount++] = v;
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[tri] = true;
+        }
+
+        // Next fanning vertex: the fan vertex that is still in the cache and stays there for its
+        // remaining triangles, preferring the oldest; otherwise fall back to skipDeadEnd
+        int next = -1;
+        int bestPriority = -1;
+        for (int c = 0; c < candidateCount; ++c) {
+            int v = candidates[c];
+            if (liveTriangles[v] <= 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        if (next == -1) {
+            next = skipDeadEnd(liveTriangles, deadEndStack, &deadEndSize, &cursor, numVertices);
+        }
+        fanning = next;
+    }
+
+    for (int k = 0; k < outputSize; ++k) {
+        indices[k] = output[k];
+    }
+
+    delete[] output;
+    delete[] candidates;
+    delete[] deadEndStack;
+    delete[] emitted;
+    delete[] cacheTime;
+    delete[] fill;
+    delete[] adjacency;
+    delete[] adjacencyStart;
+    delete[] liveTriangles;
+}
+
+// Bounding sphere and normal cone of one meshlet
+static void compute_meshlet_bounds(Meshlet& meshlet)
+{
+    const int* indices = gIndexBuffer + 3 * meshlet.firstTriangle;
+
+    // Bounding sphere around the center of the bounding box
+    glm::vec3 box_min = gVertexBuffer[indices[0]];
+    glm::vec3 box_max = box_min;
+    for (int k = 0; k < 3 * meshlet.triangleCount; ++k) {
+        box_min = glm::min(box_min, gVertexBuffer[indices[k]]);
+        box_max = glm::max(box_max, gVertexBuffer[indices[k]]);
+    }
+    meshlet.center = (box_min + box_max) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (int k = 0; k < 3 * meshlet.triangleCount; ++k) {
+        meshlet.radius = fmaxf(meshlet.radius, glm::length(gVertexBuffer[indices[k]] - meshlet.center));
+    }
+
+    // Normal cone: average direction, opened up to the widest face normal. Degenerate
+    // triangles have no direction and are skipped; the rasterizer drops them anyway.
+    glm::vec3 normals_sum(0.0f);
+    for (int tri = 0; tri < meshlet.triangleCount; ++tri) {
+        glm::vec3 v0 = gVertexBuffer[indices[3 * tri + 0]];
+        glm::vec3 normal = glm::cross(gVertexBuffer[indices[3 * tri + 1]] - v0, gVertexBuffer[indices[3 * tri + 2]] - v0);
+        if (glm::length(normal) > 1e-12f) {
+            normals_sum += glm::normalize(normal);
+        }
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneAngle = (float)M_PI;
+    if (glm::length(normals_sum) > 1e-6f) {
+        meshlet.coneAxis = glm::normalize(normals_sum);
+        float min_cosine = 1.0f;
+        for (int tri = 0; tri < meshlet.triangleCount; ++tri) {
+            glm::vec3 v0 = gVertexBuffer[indices[3 * tri + 0]];
+            glm::vec3 normal = glm::cross(gVertexBuffer[indices[3 * tri + 1]] - v0, gVertexBuffer[indices[3 * tri + 2]] - v0);
+            if (glm::length(normal) > 1e-12f) {
+                min_cosine = fminf(min_cosine, glm::dot(meshlet.coneAxis, glm::normalize(normal)));
+            }
+        }
+        meshlet.coneAngle = acosf(fmaxf(-1.0f, fminf(1.0f, min_cosine)));
+    }
+}
+
+void build_meshlets(int maxTriangles)
+{
+    // Vertex -> triangle adjacency in compressed rows
+    int* adjacencyStart = new int[gNumVertices + 1]();
+    for (int k = 0; k < 3 * gNumTriangles; ++k) {
+        adjacencyStart[gIndexBuffer[k] + 1]++;
+    }
+    for (int v = 0; v < gNumVertices; ++v) {
+        adjacencyStart[v + 1] += adjacencyStart[v];
+    }
+    int* adjacency = new int[3 * gNumTriangles];
+    int* fill = new int[gNumVertices];
+    for (int v = 0; v < gNumVertices; ++v) {
+        fill[v] = adjacencyStart[v];
+    }
+    for (int tri = 0; tri < gNumTriangles; ++tri) {
+        for (int c = 0; c < 3; ++c) {
+            int v = gIndexBuffer[3 * tri + c];
+            adjacency[fill[v]++] = tri;
+        }
+    }
+
+    glm::vec3* centroids = new glm::vec3[gNumTriangles];
+    for (int tri = 0; tri < gNumTriangles; ++tri) {
+        centroids[tri] = (gVertexBuffer[gIndexBuffer[3 * tri + 0]] +
+            gVertexBuffer[gIndexBuffer[3 * tri + 1]] +
+            gVertexBuffer[gIndexBuffer[3 * tri + 2]]) / 3.0f;
+    }
+
+    // Grow each meshlet from the first unassigned triangle in the current order, always adding
+    // the vertex-adjacent triangle closest to the meshlet's running centroid, which keeps
+    // meshlets compact and their normal cones narrow
+    int* meshletOf = new int[gNumTriangles];
+    for (int tri = 0; tri < gNumTriangles; ++tri) {
+        meshletOf[tri] = -1;
+    }
+    int* queuedIn = new int[gNumTriangles];
+    for (int tri = 0; tri < gNumTriangles; ++tri) {
+        queuedIn[tri] = -1;
+    }
+    int* candidates = new int[gNumTriangles];
+    int* meshletSize = new int[gNumTriangles];
+    int meshletCount = 0;
+    int seed = 0;
+    while (true) {
+        while (seed < gNumTriangles && meshletOf[seed] >= 0) {
+            ++seed;
+        }
+        if (seed == gNumTriangles) {
+            break;
+        }
+
+        int size = 0;
+        int candidateCount = 0;
+        glm::vec3 centroid_sum(0.0f);
+        int tri = seed;
+        queuedIn[seed] = meshletCount;
+        while (tri >= 0) {
+            meshletOf[tri] = meshletCount;
+            centroid_sum += centroids[tri];
+            ++size;
+            if (size == maxTriangles) {
+                break;
+            }
+            for (int c = 0; c < 3; ++c) {
+                int v = gIndexBuffer[3 * tri + c];
+                for (int a = adjacencyStart[v]; a < adjacencyStart[v + 1]; ++a) {
+                    int neighbor = adjacency[a];
+                    if (meshletOf[neighbor] < 0 && queuedIn[neighbor] != meshletCount) {
+                        queuedIn[neighbor] = meshletCount;
+                        candidates[candidateCount++] = neighbor;
+                    }
+                }
+            }
+
+            glm::vec3 center = centroid_sum / (float)size;
+            int best = -1;
+            float bestDistance = 0.0f;
+            int kept = 0;
+            for (int k = 0; k < candidateCount; ++k) {
+                int candidate = candidates[k];
+                if (meshletOf[candidate] >= 0) {
+                    continue; // added to the meshlet since it was queued
+                }
+                candidates[kept++] = candidate;
+                float distance = glm::length(centroids[candidate] - center);
+                if (best < 0 || distance < bestDistance) {
+                    best = candidate;
+                    bestDistance = distance;
+                }
+            }
+            candidateCount = kept;
+            tri = best;
+        }
+        meshletSize[meshletCount++] = size;
+    }
+
+    // Make every meshlet a contiguous range of the index buffer. A stable counting sort keeps
+    // the cache-optimized order inside each meshlet.
+    gNumMeshlets = meshletCount;
+    gMeshletBuffer = new Meshlet[gNumMeshlets];
+    int* nextSlot = new int[gNumMeshlets];
+    int first = 0;
+    for (int m = 0; m < gNumMeshlets; ++m) {
+        gMeshletBuffer[m].firstTriangle = first;
+        gMeshletBuffer[m].triangleCount = meshletSize[m];
+        nextSlot[m] = first;
+        first += meshletSize[m];
+    }
+    int* sorted = new int[3 * gNumTriangles];
+    for (int tri = 0; tri < gNumTriangles; ++tri) {
+        int target = nextSlot[meshletOf[tri]]++;
+        for (int c = 0; c < 3; ++c) {
+            sorted[3 * target + c] = gIndexBuffer[3 * tri + c];
+        }
+    }
+    for (int k = 0; k < 3 * gNumTriangles; ++k) {
+        gIndexBuffer[k] = sorted[k];
+    }
+
+    for (int m = 0; m < gNumMeshlets; ++m) {
+        compute_meshlet_bounds(gMeshletBuffer[m]);
+    }
+
+    delete[] sorted;
+    delete[] nextSlot;
+    delete[] meshletSize;
+    delete[] candidates;
+    delete[] queuedIn;
+    delete[] meshletOf;
+    delete[] centroids;
+    delete[] fill;
+    delete[] adjacency;
+    delete[] adjacencyStart;
+}
+
+void simulate_vertex_cache(const int* indices, int numTriangles, int numVertices, int cacheSize,
+    float* acmr, float* atvr)
+{
+    // A vertex is in the FIFO cache while fewer than cacheSize misses happened since it was loaded
+    int* loadedAt = new int[numVertices];
+    bool* referenced = new bool[numVertices]();
+    for (int v = 0; v < numVertices; ++v) {
+        loadedAt[v] = -cacheSize - 1;
+    }
+
+    int misses = 0;
+    int referencedCount = 0;
+    for (int k = 0; k < 3 * numTriangles; ++k) {
+        int v = indices[k];
+        if (misses - loadedAt[v] > cacheSize) {
+            loadedAt[v] = misses++;
+        }
+        if (!referenced[v]) {
+            referenced[v] = true;
+            referencedCount++;
+        }
+    }
+
+    *acmr = numTriangles > 0 ? (float)misses / numTriangles : 0.0f;
+    *atvr = referencedCount > 0 ? (float)misses / referencedCount : 0.0f;
+
+    delete[] referenced;
+    delete[] loadedAt;
+}
+
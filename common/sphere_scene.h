@@ -0,0 +1,47 @@
+#pragma once
+#ifndef SPHERE_SCENE_H
+#define SPHERE_SCENE_H
+
+#include <glm/vec3.hpp> 
+
+
+// Prints the vertex cache, cull, fragment and depth-block counters of the scene and the frame
+const bool printRenderStats = false;
+
+extern int gNumVertices;
+extern int gNumTriangles;
+extern int* gIndexBuffer;
+extern glm::vec3* gVertexBuffer;
+
+// Cluster of consecutive triangles in gIndexBuffer with model-space bounds, so a renderer can
+// cull the whole cluster before touching its triangles
+struct Meshlet {
+    int firstTriangle;
+    int triangleCount;
+    glm::vec3 center;   // bounding sphere
+    float radius;
+    glm::vec3 coneAxis; // normal cone around the triangles' cross(v1 - v0, v2 - v0) directions
+    float coneAngle;    // half angle in radians; pi when the normals do not fit in a cone
+};
+
+extern int gNumMeshlets;
+extern Meshlet* gMeshletBuffer;
+
+
+void create_scene();
+void delete_scene();
+
+// Reorders the triangles of an index buffer for a FIFO post-transform vertex cache with
+// cacheSize entries (Tipsify). Triangle winding is preserved.
+void optimize_index_order(int* indices, int numTriangles, int numVertices, int cacheSize);
+
+// Simulates a FIFO post-transform vertex cache with cacheSize entries over an index buffer.
+// ACMR is cache misses per triangle, ATVR is cache misses per referenced vertex (1.0 is ideal).
+void simulate_vertex_cache(const int* indices, int numTriangles, int numVertices, int cacheSize,
+    float* acmr, float* atvr);
+
+// Groups adjacent triangles of gIndexBuffer into compact meshlets of at most maxTriangles
+// triangles and reorders the triangles so each meshlet is a contiguous range
+void build_meshlets(int maxTriangles);
+
+#endif // SPHERE_SCENE_H
\ No newline at end of file